@@ -4,6 +4,7 @@
 #include <Library/PrintLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/BaseLib.h>
 #include <Protocol/LoadedImage.h>
 #include <Protocol/SimpleFileSystem.h>
 #include <Protocol/DiskIo2.h>
@@ -11,17 +12,7 @@
 #include <Guid/FileInfo.h>
 #include "frame_buffer_config.hpp"
 #include "elf.hpp"
-
-// memory mapの構造
-struct MemoryMap
-{
-    UINTN buffer_size;         // 割り当てられたバッファーのサイズ
-    VOID *buffer;              // 割り当てられたバッファーの先頭アドレス
-    UINTN map_size;            // 得られたmemory mapmのサイズ
-    UINTN map_key;             // memory mapの(時系列)識別用ID
-    UINTN descriptor_size;     // メモリマップの個々の行を表すディスクリプタのバイト数
-    UINT32 descriptor_version; // メモリディスクリプタ構造体のバージョン
-};
+#include "memory_map.hpp"
 
 // メモリマップを得るための関数。
 EFI_STATUS GetMemoryMap(struct MemoryMap *map)
@@ -90,52 +81,140 @@ const CHAR16 *GetMemoryTypeUnicode(EFI_MEMORY_TYPE type)
     }
 }
 
+// メモリマップの保存形式
+typedef enum
+{
+    kMemoryMapCsv,    // テキスト(CSV)形式
+    kMemoryMapBinary, // バイナリ形式 (tools/memmap.py で読める)
+} MemoryMapFormat;
+
+// バイナリ形式のメモリマップのヘッダ (ファイル先頭)
+#define MEMORY_MAP_DUMP_VERSION 1
+typedef struct
+{
+    CHAR8 magic[4];     // "MMAP"
+    UINT32 version;     // MEMORY_MAP_DUMP_VERSION
+    UINT32 num_entries; // エントリ数
+    UINT32 entry_size;  // エントリ1つのバイト数 (sizeof(MemoryMapDumpEntry))
+} MemoryMapDumpHeader;
+
+// バイナリ形式のメモリマップのエントリ (ヘッダの後に num_entries 個並ぶ, リトルエンディアン)
+typedef struct
+{
+    UINT32 type;
+    UINT32 reserved;
+    UINT64 physical_start;
+    UINT64 number_of_pages;
+    UINT64 attribute;
+} MemoryMapDumpEntry;
+
+// CSV形式の1行の最大バイト数 (種別名は最長で26文字, 数値は最長で16桁)
+#define MEMORY_MAP_CSV_LINE_MAX 128
+
 // 取得したメモリマップをファイルに保存する関数
-EFI_STATUS SaveMemoryMap(struct MemoryMap *map, EFI_FILE_PROTOCOL *file)
+// ディスクリプタごとにファイルへ書き込むと遅いため、全体を1つのバッファに組み立ててから1回で書き込む
+EFI_STATUS SaveMemoryMap(struct MemoryMap *map, EFI_FILE_PROTOCOL *file, MemoryMapFormat format)
 {
     EFI_STATUS status;
-    CHAR8 buf[256]; // ファイル書き込み用テキストを一時的に保存する変数
-    UINTN len;      // 書き込むバイト数を一時的に保存する変数
-
-    // ヘッダ保存の書き込み
-    CHAR8 *header =
-        "Index, Type, Type(name), PhysicalStart, NumberOfPages, Attribute\n";
-    len = AsciiStrLen(header);
-    status = file->Write(file, &len, header);
+    UINTN num_entries = map->map_size / map->descriptor_size;
+    UINTN buf_size;
+    CHAR8 *buf; // ファイル書き込み用のバッファ
+    UINTN len;  // バッファに書き込んだバイト数
+
+    Print(L"map->buffer = %08lx, map->map_size = %08lx\n",
+          map->buffer, map->map_size);
+
+    if (format == kMemoryMapBinary)
+    {
+        buf_size = sizeof(MemoryMapDumpHeader) + sizeof(MemoryMapDumpEntry) * num_entries;
+    }
+    else
+    {
+        buf_size = MEMORY_MAP_CSV_LINE_MAX * (num_entries + 1);
+    }
+    status = gBS->AllocatePool(EfiLoaderData, buf_size, (VOID **)&buf);
     if (EFI_ERROR(status))
     {
         return status;
     }
 
-    Print(L"map->buffer = %08lx, map->map_size = %08lx\n",
-          map->buffer, map->map_size);
+    if (format == kMemoryMapBinary)
+    {
+        MemoryMapDumpHeader *header = (MemoryMapDumpHeader *)buf;
+        CopyMem(header->magic, "MMAP", 4);
+        header->version = MEMORY_MAP_DUMP_VERSION;
+        header->num_entries = (UINT32)num_entries;
+        header->entry_size = sizeof(MemoryMapDumpEntry);
+        len = sizeof(MemoryMapDumpHeader);
+    }
+    else
+    {
+        // ヘッダ行
+        len = AsciiSPrint(buf, buf_size,
+                          "Index, Type, Type(name), PhysicalStart, NumberOfPages, Attribute\n");
+    }
 
-    // 取得したメモリマップを保存
+    // メモリマップを書き込んだバッファに関して、全てのディスクリプタ(行)をイテレーションする
     EFI_PHYSICAL_ADDRESS iter;
     int i;
-    // メモリマップを書き込んだバッファに関して、全てのディスクリプタ(行)をイテレーションする
     for (iter = (EFI_PHYSICAL_ADDRESS)map->buffer, i = 0;
          iter < (EFI_PHYSICAL_ADDRESS)map->buffer + map->map_size;
          iter += map->descriptor_size, i++)
     {
         // 型変換
         EFI_MEMORY_DESCRIPTOR *desc = (EFI_MEMORY_DESCRIPTOR *)iter;
-        // 個々のメモリディスクリプタをテキスト化
-        len = AsciiSPrint(
-            buf, sizeof(buf),
-            "%u, %x, %-ls, %08lx, %lx, %lx\n",
-            i, desc->Type, GetMemoryTypeUnicode(desc->Type),
-            desc->PhysicalStart, desc->NumberOfPages,
-            desc->Attribute & 0xffffflu);
-        // 書き込み
-        status = file->Write(file, &len, buf);
-        if (EFI_ERROR(status))
+        if (format == kMemoryMapBinary)
+        {
+            MemoryMapDumpEntry *entry = (MemoryMapDumpEntry *)(buf + len);
+            entry->type = desc->Type;
+            entry->reserved = 0;
+            entry->physical_start = desc->PhysicalStart;
+            entry->number_of_pages = desc->NumberOfPages;
+            entry->attribute = desc->Attribute;
+            len += sizeof(MemoryMapDumpEntry);
+        }
+        else
         {
-            return status;
+            // 個々のメモリディスクリプタをテキスト化して、バッファの末尾に追加
+            len += AsciiSPrint(
+                buf + len, buf_size - len,
+                "%u, %x, %-ls, %08lx, %lx, %lx\n",
+                i, desc->Type, GetMemoryTypeUnicode(desc->Type),
+                desc->PhysicalStart, desc->NumberOfPages,
+                desc->Attribute & 0xffffflu);
         }
     }
 
-    return EFI_SUCCESS;
+    // まとめて1回で書き込み
+    status = file->Write(file, &len, buf);
+    gBS->FreePool(buf);
+    return status;
+}
+
+// メモリマップを root_dir 直下の path に保存する関数
+EFI_STATUS SaveMemoryMapFile(EFI_FILE_PROTOCOL *root_dir, CHAR16 *path,
+                             struct MemoryMap *map, MemoryMapFormat format)
+{
+    EFI_STATUS status;
+    EFI_FILE_PROTOCOL *file;
+
+    // メモリマップを書き込むためのファイルを開く(なければ作成)
+    status = root_dir->Open(
+        root_dir, &file, path,
+        EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, 0);
+    if (EFI_ERROR(status))
+    {
+        return status;
+    }
+
+    status = SaveMemoryMap(map, file, format);
+    if (EFI_ERROR(status))
+    {
+        file->Close(file);
+        return status;
+    }
+    // 後片付け(開いたファイルを閉じる)
+    return file->Close(file);
 }
 
 // ファイル操作プロトコル?(rootディレクトリ)を開くための関数
@@ -211,6 +290,112 @@ EFI_STATUS OpenGOP(EFI_HANDLE image_handle,
     return EFI_SUCCESS;
 }
 
+// 起動時に選ぶ画面解像度 (MikanLoaderPkg.dsc の DEFINE から渡される。build -D で上書きできる)
+// 0 のとき、または指定した解像度のモードがないときは、MIKAN_MAX_AUTO_PIXELS 以下で一番画素数の多いモードを選ぶ
+#ifndef MIKAN_PREFERRED_HORIZONTAL_RESOLUTION
+#define MIKAN_PREFERRED_HORIZONTAL_RESOLUTION 0
+#endif
+#ifndef MIKAN_PREFERRED_VERTICAL_RESOLUTION
+#define MIKAN_PREFERRED_VERTICAL_RESOLUTION 0
+#endif
+// 自動選択で選ぶモードの画素数の上限
+// (画素数が多いほど画面全体の描画にかかるメモリ帯域が増えるため、大きすぎる解像度は避ける)
+#ifndef MIKAN_MAX_AUTO_PIXELS
+#define MIKAN_MAX_AUTO_PIXELS (2560 * 1600) // MikanLoaderPkg.dsc の既定値と同じ
+#endif
+
+// カーネルが対応しているピクセル形式か
+BOOLEAN IsSupportedPixelFormat(EFI_GRAPHICS_PIXEL_FORMAT fmt)
+{
+    return fmt == PixelRedGreenBlueReserved8BitPerColor ||
+           fmt == PixelBlueGreenRedReserved8BitPerColor;
+}
+
+// GOPのモードを列挙し、指定された解像度(なければ画素数の方針に従って一番良いもの)に切り替える関数
+EFI_STATUS SelectGraphicsMode(EFI_GRAPHICS_OUTPUT_PROTOCOL *gop)
+{
+    EFI_STATUS status;
+    UINT32 best_mode = gop->Mode->Mode;
+    UINT64 best_pixels = 0;
+    BOOLEAN found_preferred = FALSE;
+
+    for (UINT32 mode = 0; mode < gop->Mode->MaxMode; ++mode)
+    {
+        UINTN info_size;
+        EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *info;
+        status = gop->QueryMode(gop, mode, &info_size, &info);
+        if (EFI_ERROR(status))
+        {
+            continue;
+        }
+
+        UINT32 h = info->HorizontalResolution;
+        UINT32 v = info->VerticalResolution;
+        UINT64 pixels = (UINT64)h * v;
+        BOOLEAN supported = IsSupportedPixelFormat(info->PixelFormat);
+        FreePool(info);
+        if (!supported)
+        {
+            continue;
+        }
+
+        // 指定された解像度のモードがあれば、それを最優先する
+        if (h == MIKAN_PREFERRED_HORIZONTAL_RESOLUTION && v == MIKAN_PREFERRED_VERTICAL_RESOLUTION)
+        {
+            best_mode = mode;
+            found_preferred = TRUE;
+            break;
+        }
+        if (pixels <= MIKAN_MAX_AUTO_PIXELS && pixels > best_pixels)
+        {
+            best_mode = mode;
+            best_pixels = pixels;
+        }
+    }
+
+    if (!found_preferred && best_pixels == 0)
+    {
+        // 条件に合うモードがなければ、今のモードのまま使う
+        return EFI_SUCCESS;
+    }
+    if (best_mode == gop->Mode->Mode)
+    {
+        return EFI_SUCCESS;
+    }
+    return gop->SetMode(gop, best_mode);
+}
+
+// 画面全体を白で塗りつぶす関数
+// GOPのBlt(EfiBltVideoFill)で塗りつぶし、使えない場合は8バイト単位の書き込みで塗りつぶす
+// (1バイトずつ書き込むと、大きな画面では数MBぶんの書き込みになり起動が遅くなる)
+VOID ClearFrameBuffer(EFI_GRAPHICS_OUTPUT_PROTOCOL *gop)
+{
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL white = {255, 255, 255, 0};
+    EFI_STATUS status = gop->Blt(
+        gop, &white, EfiBltVideoFill,
+        0, 0, 0, 0,
+        gop->Mode->Info->HorizontalResolution,
+        gop->Mode->Info->VerticalResolution,
+        0);
+    if (!EFI_ERROR(status))
+    {
+        return;
+    }
+
+    UINT64 *frame_buffer = (UINT64 *)gop->Mode->FrameBufferBase;
+    UINTN count = gop->Mode->FrameBufferSize / sizeof(UINT64);
+    for (UINTN i = 0; i < count; ++i)
+    {
+        frame_buffer[i] = MAX_UINT64;
+    }
+    // 8バイトに満たない残り
+    UINT8 *tail = (UINT8 *)(frame_buffer + count);
+    for (UINTN i = 0; i < gop->Mode->FrameBufferSize % sizeof(UINT64); ++i)
+    {
+        tail[i] = 255;
+    }
+}
+
 // 1ピクセルのデータ形式をテキストに変換する関数
 const CHAR16 *GetPixelFormatUnicode(EFI_GRAPHICS_PIXEL_FORMAT fmt)
 {
@@ -258,8 +443,120 @@ void CalcLoadAddressRange(Elf64_Ehdr *ehdr, UINT64 *first, UINT64 *last)
     }
 }
 
-// elfファイル(構造体)について、LOADセグメントの内容から必要な情報を仮想アドレスにコピーする関数
-void CopyLoadSegments(Elf64_Ehdr *ehdr)
+// elfファイル(構造体)について、LOADセグメントの配置に必要なアラインメント(p_alignの最大値)を返す関数
+UINT64 CalcLoadAlignment(Elf64_Ehdr *ehdr)
+{
+    Elf64_Phdr *phdr = (Elf64_Phdr *)((UINT64)ehdr + ehdr->e_phoff);
+    UINT64 align = 0x1000;
+    for (Elf64_Half i = 0; i < ehdr->e_phnum; ++i)
+    {
+        if (phdr[i].p_type != PT_LOAD)
+            continue;
+        align = MAX(align, phdr[i].p_align);
+    }
+    return align;
+}
+
+// PIE(位置独立実行形式)のカーネルを置くメモリを確保する関数
+// size バイトを align (2MiB以上の2の累乗) の境界から確保し、先頭アドレスを *base に書き込む
+// AllocatePagesは境界を指定できないため、align ぶん多めに確保してから前後の余りを解放する
+// (MemoryAllocationLib の AllocateAlignedPages は EfiBootServicesData で確保するため使わない。
+//  ExitBootServices 後は空き領域扱いになり、カーネルが上書きしてしまう)
+EFI_STATUS AllocateKernelPages(UINT64 size, UINT64 align, UINT64 *base)
+{
+    EFI_STATUS status;
+    UINTN num_pages = EFI_SIZE_TO_PAGES(size);
+    UINTN extra_pages = EFI_SIZE_TO_PAGES(align);
+    EFI_PHYSICAL_ADDRESS addr;
+
+    status = gBS->AllocatePages(AllocateAnyPages, EfiLoaderData,
+                                num_pages + extra_pages, &addr);
+    if (EFI_ERROR(status))
+    {
+        return status;
+    }
+
+    EFI_PHYSICAL_ADDRESS aligned = (addr + align - 1) & ~(align - 1);
+    UINTN head_pages = EFI_SIZE_TO_PAGES(aligned - addr);
+    UINTN tail_pages = extra_pages - head_pages;
+    if (head_pages > 0)
+    {
+        gBS->FreePages(addr, head_pages);
+    }
+    if (tail_pages > 0)
+    {
+        gBS->FreePages(aligned + EFI_PAGES_TO_SIZE(num_pages), tail_pages);
+    }
+
+    *base = aligned;
+    return EFI_SUCCESS;
+}
+
+// コピー済みのPIEカーネルについて、.rela.dyn の再配置(R_X86_64_RELATIVE)を1回の走査で適用する関数
+// bias はリンク時のアドレス(0始まり)から実際に配置したアドレスへのずれ
+EFI_STATUS ApplyRelocations(Elf64_Ehdr *ehdr, UINT64 bias)
+{
+    Elf64_Phdr *phdr = (Elf64_Phdr *)((UINT64)ehdr + ehdr->e_phoff);
+    Elf64_Dyn *dyn = NULL;
+    for (Elf64_Half i = 0; i < ehdr->e_phnum; ++i)
+    {
+        if (phdr[i].p_type == PT_DYNAMIC)
+        {
+            dyn = (Elf64_Dyn *)(phdr[i].p_vaddr + bias);
+            break;
+        }
+    }
+    if (dyn == NULL)
+    {
+        // 再配置情報がない (絶対アドレスを含まない) カーネル
+        return EFI_SUCCESS;
+    }
+
+    // DYNAMICセグメントから再配置テーブルの場所と大きさを取得
+    UINT64 rela_addr = 0, rela_size = 0, rela_ent = sizeof(Elf64_Rela);
+    for (; dyn->d_tag != DT_NULL; ++dyn)
+    {
+        switch (dyn->d_tag)
+        {
+        case DT_RELA:
+            rela_addr = dyn->d_un.d_ptr;
+            break;
+        case DT_RELASZ:
+            rela_size = dyn->d_un.d_val;
+            break;
+        case DT_RELAENT:
+            rela_ent = dyn->d_un.d_val;
+            break;
+        }
+    }
+    // 行の大きさが壊れていると、下のループが終わらない・行の途中を読むことになる
+    if (rela_ent < sizeof(Elf64_Rela))
+    {
+        Print(L"invalid relocation entry size: %lu\n", rela_ent);
+        return EFI_LOAD_ERROR;
+    }
+
+    for (UINT64 off = 0; off < rela_size; off += rela_ent)
+    {
+        Elf64_Rela *rela = (Elf64_Rela *)(rela_addr + bias + off);
+        switch (ELF64_R_TYPE(rela->r_info))
+        {
+        case R_X86_64_NONE:
+            break;
+        case R_X86_64_RELATIVE:
+            *(UINT64 *)(rela->r_offset + bias) = bias + rela->r_addend;
+            break;
+        default:
+            // 静的リンクしたPIEでは、RELATIVE以外の再配置は出てこないはず
+            Print(L"unsupported relocation type: %lu\n", ELF64_R_TYPE(rela->r_info));
+            return EFI_UNSUPPORTED;
+        }
+    }
+    return EFI_SUCCESS;
+}
+
+// elfファイル(構造体)について、LOADセグメントの内容から必要な情報を仮想アドレス(+ bias)にコピーする関数
+void CopyLoadSegments(Elf64_Ehdr *ehdr, UINT64 bias)
 {
     // プログラムヘッダの取得
     Elf64_Phdr *phdr = (Elf64_Phdr *)((UINT64)ehdr + ehdr->e_phoff);
@@ -271,11 +568,11 @@ void CopyLoadSegments(Elf64_Ehdr *ehdr)
 
         // 一時的に保存したファイルデータ(のLOADセグメント)を仮想アドレスの場所にコピーする
         UINT64 segm_in_file = (UINT64)ehdr + phdr[i].p_offset;
-        CopyMem((VOID *)phdr[i].p_vaddr, (VOID *)segm_in_file, phdr[i].p_filesz);
+        CopyMem((VOID *)(phdr[i].p_vaddr + bias), (VOID *)segm_in_file, phdr[i].p_filesz);
 
         // セグメントのメモリ上のサイズが、ファイル上のサイズより大きい場合、メモリの余白部分について、0で埋める
         UINTN remain_bytes = phdr[i].p_memsz - phdr[i].p_filesz;
-        SetMem((VOID *)(phdr[i].p_vaddr + phdr[i].p_filesz), remain_bytes, 0);
+        SetMem((VOID *)(phdr[i].p_vaddr + bias + phdr[i].p_filesz), remain_bytes, 0);
     }
 }
 
@@ -306,21 +603,17 @@ EFI_STATUS EFIAPI UefiMain(EFI_HANDLE image_handle,
         Halt();
     }
 
-    // メモリマップを書き込むためのファイルを開く(なければ作成)
-    EFI_FILE_PROTOCOL *memmap_file;
-    status = root_dir->Open(
-        root_dir, &memmap_file, L"\\memmap",
-        EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, 0);
+    // メモリマップをCSV形式(\memmap)とバイナリ形式(\memmap.bin)で保存
+    status = SaveMemoryMapFile(root_dir, L"\\memmap", &memmap, kMemoryMapCsv);
     if (EFI_ERROR(status))
     {
         Print(L"failed to save memory map: %r\n", status);
         Halt();
     }
-    // 後片付け(開いたファイルを閉じる)
-    status = memmap_file->Close(memmap_file);
+    status = SaveMemoryMapFile(root_dir, L"\\memmap.bin", &memmap, kMemoryMapBinary);
     if (EFI_ERROR(status))
     {
-        Print(L"failed to close memory map: %r\n", status);
+        Print(L"failed to save memory map (binary): %r\n", status);
         Halt();
     }
 
@@ -333,6 +626,13 @@ EFI_STATUS EFIAPI UefiMain(EFI_HANDLE image_handle,
         Halt();
     }
 
+    // 画面モードの選択 (失敗しても今のモードのまま続ける)
+    status = SelectGraphicsMode(gop);
+    if (EFI_ERROR(status))
+    {
+        Print(L"failed to set graphics mode: %r\n", status);
+    }
+
     // グラフィック情報の取得
     Print(L"Resolution: %ux%u, Pixel Format: %s, %u pixels/line\n",
           gop->Mode->Info->HorizontalResolution,
@@ -344,12 +644,10 @@ EFI_STATUS EFIAPI UefiMain(EFI_HANDLE image_handle,
           gop->Mode->FrameBufferBase + gop->Mode->FrameBufferSize,
           gop->Mode->FrameBufferSize);
 
-    // ローダから画面描画(白で塗りつぶす)
-    UINT8 *frame_buffer = (UINT8 *)gop->Mode->FrameBufferBase;
-    for (UINTN i = 0; i < gop->Mode->FrameBufferSize; ++i)
-    {
-        frame_buffer[i] = 255;
-    }
+    // ローダから画面描画(白で塗りつぶす) と、かかった時間(TSCのサイクル数)の表示
+    UINT64 clear_start = AsmReadTsc();
+    ClearFrameBuffer(gop);
+    Print(L"Clear frame buffer: %lu cycles\n", AsmReadTsc() - clear_start);
 
     // カーネルファイルの読み込み
     EFI_FILE_PROTOCOL *kernel_file;
@@ -404,19 +702,53 @@ EFI_STATUS EFIAPI UefiMain(EFI_HANDLE image_handle,
     UINT64 kernel_first_addr, kernel_last_addr;
     CalcLoadAddressRange(kernel_ehdr, &kernel_first_addr, &kernel_last_addr);
 
-    // ページ数の計算 (4KiB単位に換算)と、メモリの確保
-    UINTN num_pages = (kernel_last_addr - kernel_first_addr + 0xfff) / 0x1000;
-    status = gBS->AllocatePages(AllocateAddress, EfiLoaderData,
-                                num_pages, &kernel_first_addr);
-    if (EFI_ERROR(status))
+    // リンク時のアドレスから実際に配置するアドレスへのずれ (固定アドレスのカーネルでは0)
+    UINT64 kernel_bias = 0;
+    if (kernel_ehdr->e_type == ET_DYN)
     {
-        Print(L"failed to allocate pages: %r\n", status);
-        Halt();
+        // PIEのカーネルは、2MiB(かつ各セグメントのp_align)境界の空いている場所に置く
+        // (2MiB境界に置いておけば、カーネルのコード・データを2MiBページでマップできる)
+        UINT64 align = MAX(CalcLoadAlignment(kernel_ehdr), 0x200000);
+        kernel_first_addr &= ~(align - 1);
+        UINT64 kernel_base;
+        status = AllocateKernelPages(kernel_last_addr - kernel_first_addr, align, &kernel_base);
+        if (EFI_ERROR(status))
+        {
+            Print(L"failed to allocate pages: %r\n", status);
+            Halt();
+        }
+        kernel_bias = kernel_base - kernel_first_addr;
+    }
+    else
+    {
+        // ページ数の計算 (4KiB単位に換算)と、メモリの確保
+        UINTN num_pages = (kernel_last_addr - kernel_first_addr + 0xfff) / 0x1000;
+        status = gBS->AllocatePages(AllocateAddress, EfiLoaderData,
+                                    num_pages, &kernel_first_addr);
+        if (EFI_ERROR(status))
+        {
+            Print(L"failed to allocate pages: %r\n", status);
+            Halt();
+        }
+    }
+
+    // LOADセグメントのコピーと、(PIEの場合)再配置の適用
+    CopyLoadSegments(kernel_ehdr, kernel_bias);
+    if (kernel_ehdr->e_type == ET_DYN)
+    {
+        status = ApplyRelocations(kernel_ehdr, kernel_bias);
+        if (EFI_ERROR(status))
+        {
+            Print(L"failed to relocate kernel: %r\n", status);
+            Halt();
+        }
     }
+    Print(L"Kernel: 0x%0lx - 0x%0lx\n",
+          kernel_first_addr + kernel_bias, kernel_last_addr + kernel_bias);
 
-    // LOADセグメントのコピー
-    CopyLoadSegments(kernel_ehdr);
-    Print(L"Kernel: 0x%0lx - 0x%0lx\n", kernel_first_addr, kernel_last_addr);
+    // カーネルのエントリポイントのアドレス
+    // (ELFヘッダのe_entryはリンク時のアドレスなので、配置したアドレスとのずれを足す)
+    UINT64 entry_addr = kernel_ehdr->e_entry + kernel_bias;
 
     // 後片付け
     // 一時ELFファイルバッファの解放
@@ -455,11 +787,6 @@ EFI_STATUS EFIAPI UefiMain(EFI_HANDLE image_handle,
         }
     }
 
-    // コピー先の先頭仮想アドレスから、カーネルのエントリポイントを取得する
-    // エントリポイントのアドレスはELF headerに格納されており、ベースアドレス(ファイルの先頭)を基準として
-    // オフセット24バイトの位置から8バイト整数として書かれている。
-    UINT64 entry_addr = *(UINT64 *)(kernel_first_addr + 24);
-
     // カーネルに渡す、フレームバッファコンフィグの取得
     struct FrameBufferConfig config = {
         (UINT8 *)gop->Mode->FrameBufferBase,
@@ -483,10 +810,12 @@ EFI_STATUS EFIAPI UefiMain(EFI_HANDLE image_handle,
     // エントリポイントの型定義と変換
     // (mac + edk2 ではCLANGPDB(Microsoft x64 ABI)でこのローダをビルドするように設定しているので、
     // この関数に関しては、ABIをSystem V AMD64 ABIに変更してビルドするように設定)
-    typedef void __attribute__((sysv_abi)) EntryPointType(const struct FrameBufferConfig *);
+    // メモリマップは ExitBootServices に成功したときのもの (以降は変化しない) をそのまま渡す
+    typedef void __attribute__((sysv_abi)) EntryPointType(const struct FrameBufferConfig *,
+                                                          const struct MemoryMap *);
     EntryPointType *entry_point = (EntryPointType *)entry_addr;
     // エントリポイントの実行
-    entry_point(&config);
+    entry_point(&config, &memmap);
 
     // ここから先はあまり意味ない
     Print(L"All done\n");
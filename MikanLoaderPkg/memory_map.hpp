@@ -0,0 +1 @@
+../kernel/memory_map.hpp
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include <cstdint>
+
+#include "boot_allocator.hpp"
+
+namespace {
+    // 1MiB未満は使わない (nullptr や レガシーな領域と重ならないように)
+    const uintptr_t kLowMemoryEnd = 0x100000;
+
+    const MemoryMap *boot_memory_map = nullptr;
+    uintptr_t        map_offset;                // 次に調べるメモリマップの行 (バッファ先頭からのバイト数)
+    uintptr_t        free_begin, free_end;      // 切り出し中の空き領域 [begin, end)
+}    // namespace
+
+void InitializeBootAllocator(const MemoryMap &memory_map)
+{
+    boot_memory_map = &memory_map;
+    map_offset      = 0;
+    free_begin = free_end = 0;
+}
+
+void *AllocateBootMemory(size_t bytes, size_t align)
+{
+    if (boot_memory_map == nullptr) {
+        return nullptr;
+    }
+
+    const uintptr_t map_base = reinterpret_cast<uintptr_t>(boot_memory_map->buffer);
+    while (true) {
+        const uintptr_t aligned = (free_begin + align - 1) & ~(align - 1);
+        if (aligned <= free_end && bytes <= free_end - aligned) {
+            free_begin = aligned + bytes;
+            return reinterpret_cast<void *>(aligned);
+        }
+
+        // 今の空き領域に収まらなければ、残りは捨てて次の空き領域へ移る
+        // (ブートサービス用の領域はローダのスタックを含むため使わない)
+        if (map_offset >= boot_memory_map->map_size) {
+            return nullptr;
+        }
+        const auto *desc = reinterpret_cast<const MemoryDescriptor *>(map_base + map_offset);
+        map_offset += boot_memory_map->descriptor_size;
+        if (desc->type != kEfiConventionalMemory) {
+            continue;
+        }
+        free_end   = desc->physical_start + desc->number_of_pages * kUEFIPageSize;
+        free_begin = desc->physical_start < kLowMemoryEnd ? kLowMemoryEnd : desc->physical_start;
+        free_begin = free_begin < free_end ? free_begin : free_end;
+    }
+}
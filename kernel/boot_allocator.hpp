@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+#include "memory_map.hpp"
+
+// UEFIのメモリマップの空き領域(EfiConventionalMemory)から、起動時に必要な大きなメモリを切り出す
+// カーネルのイメージ(.bss)は固定アドレスに置かれて大きくできないため、画面の大きさで決まるバッファはここから取る
+// 切り出したメモリは解放できない
+void InitializeBootAllocator(const MemoryMap &memory_map);
+// bytes バイトを align (2の累乗) 境界から確保して返す。空きが足りなければ nullptr を返す
+void *AllocateBootMemory(size_t bytes, size_t align);
@@ -2,45 +2,215 @@
 
 #include "console.hpp"
 #include "font.hpp"
+#include "perf.hpp"
 
-Console::Console(PixelWriter &writer, const PixelColor &fg_color, const PixelColor &bg_color)
-    : writer_{writer}, fg_color_{fg_color}, bg_color_{bg_color}, buffer_{}, cursor_row_{0}, cursor_column_{0}
+namespace {
+    // 画面に表示中のコンソール
+    Console *active_console = nullptr;
+
+    // 拡大率 scale のときの行数・列数
+    void GetGeometry(const PixelWriter &screen, int scale, int *rows, int *columns)
+    {
+        *columns = screen.Width() / (8 * scale);
+        *rows    = screen.Height() / (kFontHeight * scale);
+        *columns = *columns < Console::kColumns ? *columns : Console::kColumns;
+        *rows    = *rows < Console::kRows ? *rows : Console::kRows;
+    }
+
+    // 拡大率 scale のときに必要なサーフェスの大きさ (ピクセル)
+    size_t SurfacePixelsAt(const PixelWriter &screen, int scale)
+    {
+        int rows, columns;
+        GetGeometry(screen, scale, &rows, &columns);
+        return static_cast<size_t>(8 * scale) * columns * kFontHeight * scale * rows;
+    }
+}    // namespace
+
+size_t Console::SurfacePixels(const PixelWriter &screen)
 {
+    size_t pixels = 0;
+    for (int scale = 1; scale <= kMaxTextScale; ++scale) {
+        const size_t p = SurfacePixelsAt(screen, scale);
+        pixels         = p > pixels ? p : pixels;
+    }
+    return pixels;
+}
+
+Console::Console(PixelWriter &screen, uint32_t *surface, size_t surface_pixels, const PixelColor &fg_color,
+                 const PixelColor &bg_color, int scale)
+    : screen_{screen}, surface_{surface}, surface_pixels_{surface_pixels},
+      surface_config_{reinterpret_cast<uint8_t *>(surface), 0, 0, 0, screen.Format()}, surface_writer_buf_{},
+      surface_writer_{nullptr}, fg_color_{fg_color}, bg_color_{bg_color}, buffer_{}, cursor_row_{0},
+      cursor_column_{0}, scale_{0}, rows_{0}, columns_{0}, cell_width_{0}, cell_height_{0}, dirty_top_{0},
+      dirty_bottom_{0}
+{
+    surface_writer_ = NewPixelWriter(surface_writer_buf_, surface_config_);
+    SetScale(scale);
+}
+
+void Console::SetScale(int scale)
+{
+    if (scale < 1) {
+        scale = 1;
+    } else if (scale > kMaxTextScale) {
+        scale = kMaxTextScale;
+    }
+    // サーフェスに収まらない拡大率は使わない (SurfacePixels の大きさを渡していれば起きない)
+    while (scale > 1 && SurfacePixelsAt(screen_, scale) > surface_pixels_) {
+        --scale;
+    }
+
+    // 表示中なら、古い領域を画面から消してから、新しい大きさで行数・列数を決め直す
+    if (scale_ != 0 && IsActive()) {
+        FillRectangle(screen_, {0, 0}, {cell_width_ * columns_, cell_height_ * rows_}, bg_color_);
+    }
+    scale_       = scale;
+    cell_width_  = 8 * scale;
+    cell_height_ = kFontHeight * scale;
+    GetGeometry(screen_, scale, &rows_, &columns_);
+
+    surface_config_.pixels_per_scan_line  = cell_width_ * columns_;
+    surface_config_.horizontal_resolution = cell_width_ * columns_;
+    surface_config_.vertical_resolution   = cell_height_ * rows_;
+
+    // 画面に収まらなくなった部分は捨てる (カーソルが最終行より下なら最終行へ)
+    for (int row = 0; row < kRows; ++row) {
+        if (columns_ < kColumns && buffer_[row][columns_] == kWideContinuation) {
+            buffer_[row][columns_ - 1] = 0;
+        }
+        for (int column = columns_; column < kColumns; ++column) {
+            buffer_[row][column] = 0;
+        }
+    }
+    if (cursor_row_ >= rows_) {
+        memmove(buffer_[0], buffer_[cursor_row_ - rows_ + 1], sizeof(buffer_[0]) * rows_);
+        memset(buffer_[rows_], 0, sizeof(buffer_[0]) * (kRows - rows_));
+        cursor_row_ = rows_ - 1;
+    }
+    if (cursor_column_ >= columns_) {
+        cursor_column_ = columns_ - 1;
+    }
+    Redraw();
+    Present();
 }
 
 void Console::PutString(const char *s)
 {
+    PERF_SCOPE(kPerfConsolePutString);
     // コンソールの行サイズに気をつけながら、一文字ずつ出力 + bufferへ保存
     while (*s) {
         if (*s == '\n') {
             Newline();
-        } else if (cursor_column_ < kColumns - 1) {
-            WriteAscii(writer_, 8 * cursor_column_, 16 * cursor_row_, *s, fg_color_);
-            buffer_[cursor_row_][cursor_column_] = *s;
-            ++cursor_column_;
+            ++s;
+            continue;
+        }
+
+        char32_t c;
+        s = DecodeUtf8(s, &c);
+        // 最終列は改行用に空けておく (全角文字は2列とも収まる場合のみ出力)
+        const int columns = GetGlyph(c).width / 8;
+        if (cursor_column_ + columns < columns_) {
+            WriteUnicode(*surface_writer_, cell_width_ * cursor_column_, cell_height_ * cursor_row_, c, fg_color_,
+                         scale_);
+            MarkDirty(cell_height_ * cursor_row_, cell_height_ * (cursor_row_ + 1));
+            buffer_[cursor_row_][cursor_column_] = c;
+            if (columns == 2) {
+                buffer_[cursor_row_][cursor_column_ + 1] = kWideContinuation;
+            }
+            cursor_column_ += columns;
         }
-        ++s;
     }
+    Present();
+}
+
+void Console::Activate()
+{
+    // 前に表示していたコンソールの方が大きければ、はみ出る部分を消す
+    Console *prev = active_console;
+    if (prev != nullptr && prev != this) {
+        const int prev_w = prev->surface_config_.horizontal_resolution;
+        const int prev_h = prev->surface_config_.vertical_resolution;
+        const int w = surface_config_.horizontal_resolution, h = surface_config_.vertical_resolution;
+        if (prev_w > w) {
+            FillRectangle(screen_, {w, 0}, {prev_w - w, prev_h}, bg_color_);
+        }
+        if (prev_h > h) {
+            FillRectangle(screen_, {0, h}, {w, prev_h - h}, bg_color_);
+        }
+    }
+
+    active_console = this;
+    MarkDirty(0, cell_height_ * rows_);
+    Present();
+}
+
+bool Console::IsActive() const
+{
+    return active_console == this;
 }
 
 void Console::Newline()
 {
+    PERF_SCOPE(kPerfConsoleNewline);
     cursor_column_ = 0;
-    if (cursor_row_ < kRows - 1) {
+    if (cursor_row_ < rows_ - 1) {
         ++cursor_row_;
-    } else {
-        // clear Console
-        for (int y = 0; y < 16 * kRows; ++y) {
-            for (int x = 0; x < 8 * kColumns; ++x) {
-                writer_.Write(x, y, bg_color_);
-            }
-        }
-        // bufferの繰り上げと再描画
-        for (int row = 0; row < kRows - 1; ++row) {
-            memcpy(buffer_[row], buffer_[row + 1], kColumns + 1);
-            WriteString(writer_, 0, 16 * row, buffer_[row], fg_color_);
+        return;
+    }
+
+    // bufferの繰り上げ + buffer最終行のクリア
+    memmove(buffer_[0], buffer_[1], sizeof(buffer_[0]) * (rows_ - 1));
+    memset(buffer_[rows_ - 1], 0, sizeof(buffer_[rows_ - 1]));
+
+    // 文字を描き直す代わりに、サーフェスを1行ぶん上へずらして最終行だけ消す
+    const size_t row_pixels = static_cast<size_t>(surface_config_.pixels_per_scan_line) * cell_height_;
+    memmove(surface_, surface_ + row_pixels, sizeof(uint32_t) * row_pixels * (rows_ - 1));
+    FillRectangle(*surface_writer_, {0, cell_height_ * (rows_ - 1)}, {cell_width_ * columns_, cell_height_},
+                  bg_color_);
+    MarkDirty(0, cell_height_ * rows_);
+}
+
+void Console::Redraw()
+{
+    // clear Console
+    FillRectangle(*surface_writer_, {0, 0}, {cell_width_ * columns_, cell_height_ * rows_}, bg_color_);
+    for (int row = 0; row < rows_; ++row) {
+        RedrawRow(row);
+    }
+    MarkDirty(0, cell_height_ * rows_);
+}
+
+void Console::RedrawRow(int row)
+{
+    for (int column = 0; column < columns_; ++column) {
+        const char32_t c = buffer_[row][column];
+        if (c != 0 && c != kWideContinuation) {
+            WriteUnicode(*surface_writer_, cell_width_ * column, cell_height_ * row, c, fg_color_, scale_);
         }
-        // buffer最終行のクリア
-        memset(buffer_[kRows - 1], 0, kColumns + 1);
     }
-}
\ No newline at end of file
+}
+
+void Console::MarkDirty(int y0, int y1)
+{
+    if (dirty_top_ == dirty_bottom_) {
+        dirty_top_    = y0;
+        dirty_bottom_ = y1;
+        return;
+    }
+    dirty_top_    = y0 < dirty_top_ ? y0 : dirty_top_;
+    dirty_bottom_ = y1 > dirty_bottom_ ? y1 : dirty_bottom_;
+}
+
+void Console::Present()
+{
+    // 表示中でないコンソールは、変更の範囲を溜めておくだけ (Activate で全体を転送する)
+    if (!IsActive() || dirty_top_ == dirty_bottom_) {
+        return;
+    }
+
+    const int width = surface_config_.pixels_per_scan_line;
+    for (int y = dirty_top_; y < dirty_bottom_; ++y) {
+        screen_.WriteRow(0, y, width, surface_ + static_cast<size_t>(width) * y);
+    }
+    dirty_top_ = dirty_bottom_ = 0;
+}
@@ -1,19 +1,61 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #include "graphics.hpp"
 
+// 文字を描画するコンソール
+// 文字はまず自分専用のオフスクリーンのサーフェス(画面と同じピクセル形式のメモリ)に描き、
+// 表示中(アクティブ)のコンソールだけが、変更のあった行をサーフェスから画面へ転送する
+// 複数のコンソールを作って Activate で切り替えられる (切り替えはサーフェスの転送1回で済む)
 class Console {
   public:
+    // 行数・列数の上限 (実際の行数・列数は画面の大きさと文字の拡大率から決まる)
     static const int kRows = 25, kColumns = 80;
 
-    Console(PixelWriter &writer, const PixelColor &fg_color, const PixelColor &bg_color);
+    // screen 上のコンソールが、どの拡大率でも収まるサーフェスの大きさ (ピクセル)
+    static size_t SurfacePixels(const PixelWriter &screen);
+
+    // surface は surface_pixels ピクセルぶんのメモリで、このコンソールが専有する
+    // (SurfacePixels(screen) より小さい場合は、収まらない拡大率を使わない)
+    Console(PixelWriter &screen, uint32_t *surface, size_t surface_pixels, const PixelColor &fg_color,
+            const PixelColor &bg_color, int scale = 1);
+    // UTF-8の文字列を出力する。全角文字は2列ぶんを使う
+    // 表示中でなければ画面には一切触れない
     void PutString(const char *s);
+    // 文字の拡大率を変更し、行数・列数・セルの大きさを合わせて再描画する
+    void SetScale(int scale);
+    // このコンソールを表示中にし、サーフェス全体を画面へ転送する
+    void Activate();
+    bool IsActive() const;
+
+    int Rows() const { return rows_; }
+    int Columns() const { return columns_; }
 
   private:
+    // 全角文字の右半分のセルに入れる値 (このセルは描画しない)
+    static const char32_t kWideContinuation = 0xffffffff;
+
     void Newline();
+    void Redraw();
+    void RedrawRow(int row);
+    // サーフェスの [y0, y1) 行が変更されたことを記録する
+    void MarkDirty(int y0, int y1);
+    // 表示中なら、変更のあった行をサーフェスから画面へ転送する
+    void Present();
 
-    PixelWriter     &writer_;
-    const PixelColor fg_color_, bg_color_;
-    char             buffer_[kRows][kColumns + 1];    // 改行用に列数 + 1
-    int              cursor_row_, cursor_column_;
-};
\ No newline at end of file
+    PixelWriter      &screen_;
+    uint32_t         *surface_;
+    const size_t      surface_pixels_;
+    FrameBufferConfig surface_config_;
+    char              surface_writer_buf_[kPixelWriterSize];
+    PixelWriter      *surface_writer_;
+    const PixelColor  fg_color_, bg_color_;
+    char32_t          buffer_[kRows][kColumns];    // 各セルの文字 (0 は空白)
+    int               cursor_row_, cursor_column_;
+    int               scale_;
+    int               rows_, columns_;                 // 現在の行数・列数
+    int               cell_width_, cell_height_;       // 1セルの大きさ (ピクセル)
+    int               dirty_top_, dirty_bottom_;       // 画面へ未転送の行の範囲 (ピクセル, [top, bottom))
+};
@@ -0,0 +1,56 @@
+#include "desktop.hpp"
+#include "font.hpp"
+#include "image.hpp"
+
+// objcopyでリンクした壁紙画像 (wallpaper.qoi)
+extern const uint8_t _binary_wallpaper_qoi_start[];
+extern const uint8_t _binary_wallpaper_qoi_end[];
+// objcopyでリンクしたロゴ画像 (logo.qoi, アルファチャンネルつき)
+extern const uint8_t _binary_logo_qoi_start[];
+extern const uint8_t _binary_logo_qoi_end[];
+
+namespace {
+    const char mouse_cursor_shape[kMouseCursorHeight][kMouseCursorWidth + 1] = {
+        "@              ", "@@             ", "@.@            ", "@..@           ", "@...@          ", "@....@         ",
+        "@.....@        ", "@......@       ", "@.......@      ", "@........@     ", "@.........@    ", "@..........@   ",
+        "@...........@  ", "@............@ ", "@......@@@@@@@@", "@......@       ", "@....@@.@      ", "@...@ @.@      ",
+        "@..@   @.@     ", "@.@    @.@     ", "@@      @.@    ", "@       @.@    ", "         @.@   ", "         @@@   ",
+    };
+}    // namespace
+
+void DrawDesktop(PixelWriter &writer)
+{
+    const int kFrameWidth  = writer.Width();
+    const int kFrameHeight = writer.Height();
+
+    // 背景の描画 (壁紙を画面の大きさに合わせて描き、壊れていれば単色で塗る)
+    const size_t wallpaper_size = _binary_wallpaper_qoi_end - _binary_wallpaper_qoi_start;
+    if (!DrawQoiImage(writer, _binary_wallpaper_qoi_start, wallpaper_size, {0, 0}, {kFrameWidth, kFrameHeight - 50})) {
+        FillRectangle(writer, {0, 0}, {kFrameWidth, kFrameHeight - 50}, kDesktopBGColor);
+    }
+    FillRectangle(writer, {0, kFrameHeight - 50}, {kFrameWidth, 50}, {1, 8, 17});
+    FillRectangle(writer, {0, kFrameHeight - 50}, {kFrameWidth / 5, 50}, {80, 80, 80});
+    DrawRectangle(writer, {10, kFrameHeight - 40}, {30, 30}, {160, 160, 160});
+    DrawLogo(writer, {11, kFrameHeight - 39});
+    // タスクバーの文字は下地と混ぜて描き、縁を滑らかにする
+    BlendString(writer, 50, kFrameHeight - 33, "MikanOS", kDesktopFGColor);
+}
+
+void DrawLogo(PixelWriter &writer, const Vector2D<int> &pos)
+{
+    const size_t logo_size = _binary_logo_qoi_end - _binary_logo_qoi_start;
+    DrawQoiImage(writer, _binary_logo_qoi_start, logo_size, pos, {kLogoSize, kLogoSize});
+}
+
+void DrawMouseCursor(PixelWriter &writer, const Vector2D<int> &pos)
+{
+    for (int dy = 0; dy < kMouseCursorHeight; ++dy) {
+        for (int dx = 0; dx < kMouseCursorWidth; ++dx) {
+            if (mouse_cursor_shape[dy][dx] == '@') {
+                writer.Write(pos.x + dx, pos.y + dy, {0, 0, 0});
+            } else if (mouse_cursor_shape[dy][dx] == '.') {
+                writer.Write(pos.x + dx, pos.y + dy, {255, 255, 255});
+            }
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "graphics.hpp"
+
+const PixelColor kDesktopBGColor{45, 118, 237};
+const PixelColor kDesktopFGColor{255, 255, 255};
+
+// タスクバーのロゴ (logo.qoi) の大きさ
+const int kLogoSize = 28;
+
+const int kMouseCursorWidth  = 15;
+const int kMouseCursorHeight = 24;
+
+// 壁紙(壊れていれば単色)とタスクバーを画面全体に描画する
+void DrawDesktop(PixelWriter &writer);
+// ロゴを pos を左上として下地に重ねて描画する (縁が半透明の画像)
+void DrawLogo(PixelWriter &writer, const Vector2D<int> &pos);
+// マウスカーソルを pos を左上として描画する (カーソルの形の外側には触れない)
+void DrawMouseCursor(PixelWriter &writer, const Vector2D<int> &pos);
@@ -12,6 +12,9 @@ typedef int64_t Elf64_Sxword;
 
 #define EI_NIDENT 16
 
+#define ET_EXEC 2 // 固定アドレスの実行ファイル
+#define ET_DYN 3  // 位置独立の実行ファイル(PIE)・共有ライブラリ
+
 typedef struct
 {
     unsigned char e_ident[EI_NIDENT];
@@ -77,4 +80,5 @@ typedef struct
 #define ELF64_R_TYPE(i) ((i)&0xffffffffL)
 #define ELF64_R_INFO(s, t) (((s) << 32) + ((t)&0xffffffffL))
 
+#define R_X86_64_NONE 0
 #define R_X86_64_RELATIVE 8
@@ -1,37 +1,132 @@
 #include "font.hpp"
+#include "perf.hpp"
 
-extern const uint8_t _binary_hankaku_bin_start;
-extern const uint8_t _binary_hankaku_bin_end;
-extern const uint8_t _binary_hankaku_bin_size;
+// tools/makefont.py がビルド時に hankaku.txt, zenkaku.txt から生成する
+// (kFontRuns, kFontGlyphs, kFontPageIndex, kFontPages)
+#include "hankaku_font.inc"
 
-const uint8_t *GetFont(char c)
+namespace {
+    // 拡大率を 1〜kMaxTextScale に収める (BlendUnicode の作業領域はこの範囲でしか足りない)
+    int ClampScale(int scale)
+    {
+        return scale < 1 ? 1 : (scale > kMaxTextScale ? kMaxTextScale : scale);
+    }
+}    // namespace
+
+const FontGlyph &GetGlyph(char32_t c)
+{
+    // 2段の表を引くだけなので、文字数によらずO(1)
+    if (c > 0xffff) {
+        return kFontGlyphs[kFontMissingGlyph];
+    }
+    return kFontGlyphs[kFontPages[kFontPageIndex[c >> 8]][c & 0xff]];
+}
+
+const FontRun *GetGlyphRow(const FontGlyph &glyph, int row, int *count)
 {
-    auto index = 16 * static_cast<unsigned int>(c);
-    if (index >= reinterpret_cast<uintptr_t>(&_binary_hankaku_bin_size)) {
-        return nullptr;
+    *count = glyph.row_begin[row + 1] - glyph.row_begin[row];
+    return &kFontRuns[glyph.first_run + glyph.row_begin[row]];
+}
+
+const uint8_t *GetGlyphCoverage(const FontGlyph &glyph, int row)
+{
+    return &kFontCoverage[glyph.coverage + glyph.width * row];
+}
+
+const char *DecodeUtf8(const char *s, char32_t *c)
+{
+    const auto *u = reinterpret_cast<const uint8_t *>(s);
+    int         len;
+    char32_t    cp;
+    if (u[0] < 0x80) {
+        *c = u[0];
+        return s + 1;
+    } else if ((u[0] & 0xe0) == 0xc0) {
+        len = 2, cp = u[0] & 0x1f;
+    } else if ((u[0] & 0xf0) == 0xe0) {
+        len = 3, cp = u[0] & 0x0f;
+    } else if ((u[0] & 0xf8) == 0xf0) {
+        len = 4, cp = u[0] & 0x07;
+    } else {
+        *c = 0xfffd;
+        return s + 1;
+    }
+
+    for (int i = 1; i < len; ++i) {
+        // 途中で途切れている場合(終端文字を含む)は、先頭バイトだけ読み飛ばす
+        if ((u[i] & 0xc0) != 0x80) {
+            *c = 0xfffd;
+            return s + 1;
+        }
+        cp = (cp << 6) | (u[i] & 0x3f);
     }
-    return &_binary_hankaku_bin_start + index;
+    *c = cp;
+    return s + len;
 }
 
-void WriteAscii(PixelWriter &writer, int x, int y, char c, const PixelColor &color)
+int WriteUnicode(PixelWriter &writer, int x, int y, char32_t c, const PixelColor &color, int scale)
 {
-    const uint8_t *font = GetFont(c);
-    if (font == nullptr) {
-        return;
+    PERF_SCOPE(kPerfWriteGlyph);
+    const FontGlyph &glyph = GetGlyph(c);
+    scale                  = ClampScale(scale);
+
+    // 1ビットずつ調べる代わりに、生成済みのランをそのまま横線として描く
+    // 拡大時はランの位置と長さを scale 倍し、同じ横線を scale 行ぶん描く
+    // (ピクセルごとに scale x scale の矩形を塗るより、横線の本数がずっと少ない)
+    for (int dy = 0; dy < kFontHeight; ++dy) {
+        int            count;
+        const FontRun *runs = GetGlyphRow(glyph, dy, &count);
+        for (int sy = 0; sy < scale; ++sy) {
+            for (int i = 0; i < count; ++i) {
+                writer.WriteSpan(x + scale * runs[i].x, y + scale * dy + sy, scale * runs[i].len, color);
+            }
+        }
     }
+    return scale * glyph.width;
+}
 
-    for (int dy = 0; dy < 16; ++dy) {
-        for (int dx = 0; dx < 8; ++dx) {
-            if ((font[dy] << dx) & 0x80u) {
-                writer.Write(x + dx, y + dy, color);
+int BlendUnicode(PixelWriter &writer, int x, int y, char32_t c, const PixelColor &color, int scale)
+{
+    PERF_SCOPE(kPerfBlendGlyph);
+    const FontGlyph &glyph = GetGlyph(c);
+    scale                  = ClampScale(scale);
+
+    // 拡大時は被覆率の行を横に scale 倍へ引き伸ばしてから、scale 行ぶん合成する
+    uint8_t scaled[16 * kMaxTextScale];
+    for (int dy = 0; dy < kFontHeight; ++dy) {
+        const uint8_t *coverage = GetGlyphCoverage(glyph, dy);
+        if (scale > 1) {
+            for (int dx = 0; dx < glyph.width * scale; ++dx) {
+                scaled[dx] = coverage[dx / scale];
             }
+            coverage = scaled;
+        }
+        for (int sy = 0; sy < scale; ++sy) {
+            writer.BlendSpan(x, y + scale * dy + sy, scale * glyph.width, coverage, color);
         }
     }
+    return scale * glyph.width;
+}
+
+void BlendString(PixelWriter &writer, int x, int y, const char *s, const PixelColor &color, int scale)
+{
+    while (*s) {
+        char32_t c;
+        s = DecodeUtf8(s, &c);
+        x += BlendUnicode(writer, x, y, c, color, scale);
+    }
+}
+
+void WriteAscii(PixelWriter &writer, int x, int y, char c, const PixelColor &color, int scale)
+{
+    WriteUnicode(writer, x, y, static_cast<unsigned char>(c), color, scale);
 };
 
-void WriteString(PixelWriter &writer, int x, int y, const char *s, const PixelColor &color)
+void WriteString(PixelWriter &writer, int x, int y, const char *s, const PixelColor &color, int scale)
 {
-    for (int i = 0; s[i] != '\0'; ++i) {
-        WriteAscii(writer, x + 8 * i, y, s[i], color);
+    while (*s) {
+        char32_t c;
+        s = DecodeUtf8(s, &c);
+        x += WriteUnicode(writer, x, y, c, color, scale);
     }
-}
\ No newline at end of file
+}
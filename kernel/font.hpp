@@ -4,5 +4,44 @@
 
 #include "graphics.hpp"
 
-void WriteAscii(PixelWriter &writer, int x, int y, char c, const PixelColor &color);
-void WriteString(PixelWriter &writer, int x, int y, const char *s, const PixelColor &color);
\ No newline at end of file
+const int kFontHeight = 16;
+// 文字の拡大率の上限 (8x16 のグリフを最大 32x64 で描く)
+const int kMaxTextScale = 4;
+
+// グリフ1行の中で、不透明なピクセルが連続する区間
+struct FontRun
+{
+    uint8_t x, len;
+};
+
+// グリフの情報 (ビットマップの代わりに、行ごとのランで形状を表す)
+// 第 row 行のランは kFontRuns[first_run + row_begin[row]] から kFontRuns[first_run + row_begin[row + 1]] の手前まで
+// 半透明描画用の被覆率(0-255)は kFontCoverage[coverage] から width x kFontHeight バイト
+struct FontGlyph
+{
+    uint32_t coverage;
+    uint16_t first_run;
+    uint8_t  width;    // 8 (半角) または 16 (全角)
+    uint8_t  row_begin[kFontHeight + 1];
+};
+
+// コードポイントに対応するグリフを返す (フォントにない文字は '?' のグリフ)
+const FontGlyph &GetGlyph(char32_t c);
+// グリフの第 row 行のランの先頭を返し、ラン数を *count に書き込む
+const FontRun *GetGlyphRow(const FontGlyph &glyph, int row, int *count);
+// グリフの第 row 行の被覆率 (glyph.width バイト) を返す
+const uint8_t *GetGlyphCoverage(const FontGlyph &glyph, int row);
+// UTF-8の文字列 s から1文字を読み、コードポイントを *c に書き込んで、次の文字の位置を返す
+// 不正なバイト列は1バイトずつ U+FFFD として読み飛ばす
+const char *DecodeUtf8(const char *s, char32_t *c);
+
+// 1文字を scale 倍(1〜kMaxTextScale の整数倍。範囲外は丸める)に拡大して描画し、描画した幅(ピクセル)を返す
+int  WriteUnicode(PixelWriter &writer, int x, int y, char32_t c, const PixelColor &color, int scale = 1);
+void WriteAscii(PixelWriter &writer, int x, int y, char c, const PixelColor &color, int scale = 1);
+// UTF-8の文字列を描画する
+void WriteString(PixelWriter &writer, int x, int y, const char *s, const PixelColor &color, int scale = 1);
+
+// 被覆率つきのグリフを、下地の色と混ぜ合わせて(アンチエイリアスをかけて)描画する
+// 背景が単色でない場所(デスクトップ上など)に文字を書くときに使う
+int  BlendUnicode(PixelWriter &writer, int x, int y, char32_t c, const PixelColor &color, int scale = 1);
+void BlendString(PixelWriter &writer, int x, int y, const char *s, const PixelColor &color, int scale = 1);
@@ -1,4 +1,63 @@
+#include <emmintrin.h>
+
+#include <cstring>
+
 #include "graphics.hpp"
+#include "perf.hpp"
+
+namespace {
+    // 16bit の各要素 t (0 <= t <= 255*255) について、round(t / 255) を除算なしで求める
+    inline __m128i Div255(__m128i t)
+    {
+        t = _mm_add_epi16(t, _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    inline uint32_t Div255(uint32_t t)
+    {
+        t += 128;
+        return (t + (t >> 8)) >> 8;
+    }
+
+    // 1ピクセル(4バイト)の各バイトについて (src * a + dst * (255 - a)) / 255 を求める
+    uint32_t BlendPixel(uint32_t src, uint32_t dst, uint32_t a)
+    {
+        uint32_t result = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            const uint32_t s = (src >> shift) & 0xff, d = (dst >> shift) & 0xff;
+            result |= Div255(s * a + d * (255 - a)) << shift;
+        }
+        return result;
+    }
+
+    // 乗算済みアルファの src を dst に重ねる: src + dst * (255 - a) / 255
+    uint32_t CompositePixel(uint32_t src, uint32_t dst)
+    {
+        const uint32_t a      = src >> 24;
+        uint32_t       result = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            const uint32_t s = (src >> shift) & 0xff, d = (dst >> shift) & 0xff;
+            const uint32_t v = s + Div255(d * (255 - a));
+            result |= (v > 255 ? 255 : v) << shift;
+        }
+        return result;
+    }
+}    // namespace
+
+// 配置new (main.cpp で定義)
+void *operator new(size_t size, void *buf);
+
+PixelWriter *NewPixelWriter(void *buf, const FrameBufferConfig &config)
+{
+    // ピクセルの形式で描画クラスを変更する (ポリモフィズム)
+    switch (config.pixel_format) {
+        case kPixelRGBResv8BitPerColor:
+            return new (buf) RGBResv8BitPerColorPixelWriter{config};
+        case kPixelBGRResv8BitPerColor:
+            return new (buf) BGRResv8BitPerColorPixelWriter{config};
+    }
+    return nullptr;
+}
 
 PixelWriter::PixelWriter(const FrameBufferConfig &config) : config_{config} {}
 
@@ -7,6 +66,112 @@ uint8_t *PixelWriter::PixelAt(int x, int y)
     return config_.frame_buffer + 4 * (config_.pixels_per_scan_line * y + x);
 }
 
+void PixelWriter::WriteSpan(int x, int y, int len, const PixelColor &c)
+{
+    PERF_SCOPE(kPerfWriteSpan);
+    const uint32_t value = PackColor(c);
+    auto           p     = reinterpret_cast<uint32_t *>(PixelAt(x, y));
+    for (int i = 0; i < len; ++i) {
+        p[i] = value;
+    }
+}
+
+void PixelWriter::BlendSpan(int x, int y, int len, const uint8_t *coverage, const PixelColor &c)
+{
+    PERF_SCOPE(kPerfBlendSpan);
+    const uint32_t value = PackColor(c);
+    auto           p     = reinterpret_cast<uint32_t *>(PixelAt(x, y));
+
+    // SSE2で4ピクセルずつ、各バイトを16bitに広げて合成する
+    // (色の並びはフレームバッファの形式のまま扱うので、RGB/BGRの変換は不要)
+    const __m128i zero   = _mm_setzero_si128();
+    const __m128i all255 = _mm_set1_epi16(255);
+    const __m128i src16  = _mm_unpacklo_epi8(_mm_set1_epi32(value), zero);
+    const __m128i src32  = _mm_set1_epi32(value);
+    int           i      = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint32_t a4;
+        memcpy(&a4, coverage + i, sizeof(a4));
+        // 完全に透明な4ピクセルは読み書きせず、完全に不透明な4ピクセルは下地を読まずに書く
+        if (a4 == 0) {
+            continue;
+        }
+        if (a4 == 0xffffffffu) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), src32);
+            continue;
+        }
+
+        // 被覆率 a0..a3 を、各ピクセルの4バイトぶんに複製する
+        __m128i a = _mm_cvtsi32_si128(static_cast<int>(a4));
+        a         = _mm_unpacklo_epi8(a, a);
+        a         = _mm_unpacklo_epi16(a, a);
+        const __m128i a_lo = _mm_unpacklo_epi8(a, zero), a_hi = _mm_unpackhi_epi8(a, zero);
+
+        const __m128i dst    = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        const __m128i dst_lo = _mm_unpacklo_epi8(dst, zero), dst_hi = _mm_unpackhi_epi8(dst, zero);
+
+        // (src * a + dst * (255 - a)) / 255  (16bitに収まる: 255 * 255 = 65025)
+        const __m128i lo = Div255(_mm_add_epi16(_mm_mullo_epi16(src16, a_lo),
+                                                _mm_mullo_epi16(dst_lo, _mm_sub_epi16(all255, a_lo))));
+        const __m128i hi = Div255(_mm_add_epi16(_mm_mullo_epi16(src16, a_hi),
+                                                _mm_mullo_epi16(dst_hi, _mm_sub_epi16(all255, a_hi))));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), _mm_packus_epi16(lo, hi));
+    }
+    for (; i < len; ++i) {
+        if (coverage[i] == 255) {
+            p[i] = value;
+        } else if (coverage[i] != 0) {
+            p[i] = BlendPixel(value, p[i], coverage[i]);
+        }
+    }
+}
+
+void PixelWriter::CompositeSpan(int x, int y, int len, const uint32_t *src)
+{
+    PERF_SCOPE(kPerfCompositeSpan);
+    auto p = reinterpret_cast<uint32_t *>(PixelAt(x, y));
+
+    const __m128i zero     = _mm_setzero_si128();
+    const __m128i opaque   = _mm_set1_epi32(255);
+    const __m128i all_ones = _mm_set1_epi32(-1);
+    int           i        = 0;
+    for (; i + 4 <= len; i += 4) {
+        const __m128i s     = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i alpha = _mm_srli_epi32(s, 24);
+        // 乗算済みアルファなので、透明なピクセルは全バイトが0になる
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) == 0xffff) {
+            continue;
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, opaque)) == 0xffff) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), s);
+            continue;
+        }
+
+        // 255 - a を各ピクセルの4バイトぶんに複製する (8bitでは 255 - a == ~a)
+        __m128i inv = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 8));
+        inv         = _mm_xor_si128(_mm_or_si128(inv, _mm_slli_epi32(inv, 16)), all_ones);
+        const __m128i inv_lo = _mm_unpacklo_epi8(inv, zero), inv_hi = _mm_unpackhi_epi8(inv, zero);
+
+        const __m128i dst    = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        const __m128i dst_lo = Div255(_mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), inv_lo));
+        const __m128i dst_hi = Div255(_mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), inv_hi));
+        // src + dst * (255 - a) / 255
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), _mm_adds_epu8(s, _mm_packus_epi16(dst_lo, dst_hi)));
+    }
+    for (; i < len; ++i) {
+        if ((src[i] >> 24) == 255) {
+            p[i] = src[i];
+        } else if (src[i] != 0) {
+            p[i] = CompositePixel(src[i], p[i]);
+        }
+    }
+}
+
+void PixelWriter::WriteRow(int x, int y, int len, const uint32_t *src)
+{
+    memcpy(PixelAt(x, y), src, 4 * len);
+}
+
 void RGBResv8BitPerColorPixelWriter::Write(int x, int y, const PixelColor &c)
 {
     auto p = PixelAt(x, y);
@@ -15,6 +180,11 @@ void RGBResv8BitPerColorPixelWriter::Write(int x, int y, const PixelColor &c)
     p[2]   = c.b;
 }
 
+uint32_t RGBResv8BitPerColorPixelWriter::PackColor(const PixelColor &c) const
+{
+    return c.r | (c.g << 8) | (c.b << 16);
+}
+
 void BGRResv8BitPerColorPixelWriter::Write(int x, int y, const PixelColor &c)
 {
     auto p = PixelAt(x, y);
@@ -23,12 +193,15 @@ void BGRResv8BitPerColorPixelWriter::Write(int x, int y, const PixelColor &c)
     p[2]   = c.r;
 }
 
+uint32_t BGRResv8BitPerColorPixelWriter::PackColor(const PixelColor &c) const
+{
+    return c.b | (c.g << 8) | (c.r << 16);
+}
+
 void DrawRectangle(PixelWriter &writer, const Vector2D<int> &pos, const Vector2D<int> &size, const PixelColor &c)
 {
-    for (int dx = 0; dx < size.x; ++dx) {
-        writer.Write(pos.x + dx, pos.y, c);
-        writer.Write(pos.x + dx, pos.y + size.y - 1, c);
-    }
+    writer.WriteSpan(pos.x, pos.y, size.x, c);
+    writer.WriteSpan(pos.x, pos.y + size.y - 1, size.x, c);
     for (int dy = 1; dy < size.y - 1; ++dy) {
         writer.Write(pos.x, pos.y + dy, c);
         writer.Write(pos.x + size.x - 1, pos.y + dy, c);
@@ -37,9 +210,8 @@ void DrawRectangle(PixelWriter &writer, const Vector2D<int> &pos, const Vector2D
 
 void FillRectangle(PixelWriter &writer, const Vector2D<int> &pos, const Vector2D<int> &size, const PixelColor &c)
 {
+    PERF_SCOPE(kPerfFillRectangle);
     for (int dy = 0; dy < size.y; ++dy) {
-        for (int dx = 0; dx < size.x; ++dx) {
-            writer.Write(pos.x + dx, pos.y + dy, c);
-        }
+        writer.WriteSpan(pos.x, pos.y + dy, size.x, c);
     }
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 #include "frame_buffer_config.hpp"
 
 struct PixelColor
@@ -14,11 +16,27 @@ class PixelWriter {
     virtual ~PixelWriter() = default;
     virtual void Write(int x, int y,
                        const PixelColor &c) = 0;    // 純粋仮想関数 (オーバーライドされないとエラーになる)
+    // (x, y) から右へ len ピクセルを同じ色で塗る。1ピクセルずつ Write を呼ぶより速い
+    void WriteSpan(int x, int y, int len, const PixelColor &c);
+    // (x, y) から右へ len ピクセルに、色 c を被覆率 coverage[i] (0-255) で下地と混ぜて書く
+    void BlendSpan(int x, int y, int len, const uint8_t *coverage, const PixelColor &c);
+    // (x, y) から右へ len ピクセルに、乗算済みアルファ形式の画像 src を下地に重ねる (source-over)
+    // src はフレームバッファと同じピクセル形式で、予約バイト(4バイト目)をアルファ値として使う
+    void CompositeSpan(int x, int y, int len, const uint32_t *src);
+    // (x, y) から右へ len ピクセルに、フレームバッファと同じ形式のピクセル列 src をそのまま書く
+    void WriteRow(int x, int y, int len, const uint32_t *src);
+
+    // 描画可能な領域の大きさ (解像度)
+    int Width() const { return config_.horizontal_resolution; }
+    int Height() const { return config_.vertical_resolution; }
+    PixelFormat Format() const { return config_.pixel_format; }
 
   protected:
     // 指定された座標のピクセルに関して、フレームバッファ上のアドレスを返す
     // 一つのピクセルあたり4バイトの大きさをもつ。
     uint8_t *PixelAt(int x, int y);
+    // 色を、フレームバッファ上の1ピクセル(4バイト)の並びに変換する
+    virtual uint32_t PackColor(const PixelColor &c) const = 0;
 
   private:
     const FrameBufferConfig &config_;
@@ -31,6 +49,9 @@ class RGBResv8BitPerColorPixelWriter : public PixelWriter {
 
     // override はつけなくても動くが、わかりやすくなるのでつけた方が良い
     virtual void Write(int x, int y, const PixelColor &c) override;
+
+  protected:
+    virtual uint32_t PackColor(const PixelColor &c) const override;
 };
 
 // BGR形式のピクセルフォーマットに対する、ピクセル描画クラス
@@ -39,8 +60,19 @@ class BGRResv8BitPerColorPixelWriter : public PixelWriter {
     using PixelWriter::PixelWriter;
 
     virtual void Write(int x, int y, const PixelColor &c) override;
+
+  protected:
+    virtual uint32_t PackColor(const PixelColor &c) const override;
 };
 
+// 描画クラス(どちらのピクセル形式でも)を配置newで作るのに必要なメモリの大きさ
+const size_t kPixelWriterSize = sizeof(RGBResv8BitPerColorPixelWriter) > sizeof(BGRResv8BitPerColorPixelWriter)
+                                    ? sizeof(RGBResv8BitPerColorPixelWriter)
+                                    : sizeof(BGRResv8BitPerColorPixelWriter);
+
+// config のピクセル形式に合った描画クラスを、buf (kPixelWriterSize バイト以上) 上に配置newで作成する
+PixelWriter *NewPixelWriter(void *buf, const FrameBufferConfig &config);
+
 template <typename T> struct Vector2D
 {
     T x, y;
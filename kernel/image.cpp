@@ -0,0 +1,71 @@
+#include "image.hpp"
+#include "perf.hpp"
+#include "qoi.hpp"
+
+namespace {
+    // 1行ぶんの作業領域 (展開した元画像の行と、拡大縮小後の行)
+    uint32_t src_row[kMaxImageWidth];
+    uint32_t dst_row[kMaxImageWidth];
+}    // namespace
+
+bool DrawQoiImage(PixelWriter &writer, const uint8_t *data, size_t data_size, const Vector2D<int> &pos,
+                  const Vector2D<int> &size)
+{
+    PERF_SCOPE(kPerfDrawImage);
+    QoiDecoder decoder;
+    if (!decoder.Open(data, data_size) || decoder.Width() > kMaxImageWidth || size.x <= 0 || size.y <= 0) {
+        return false;
+    }
+    const int src_w = decoder.Width(), src_h = decoder.Height();
+
+    // 画面内に収まる範囲 [x0, x1) x [y0, y1) (pos からの相対座標)
+    const int x0 = pos.x < 0 ? -pos.x : 0;
+    const int y0 = pos.y < 0 ? -pos.y : 0;
+    const int x1 = pos.x + size.x > writer.Width() ? writer.Width() - pos.x : size.x;
+    const int y1 = pos.y + size.y > writer.Height() ? writer.Height() - pos.y : size.y;
+    if (x0 >= x1 || y0 >= y1) {
+        return true;
+    }
+    if (x1 - x0 > kMaxImageWidth) {
+        return false;
+    }
+
+    // 出力先の列 dx に対応する元画像の列は (dx * src_w) / size.x (16.16固定小数点で進める)
+    const uint64_t step_x = (static_cast<uint64_t>(src_w) << 16) / size.x;
+
+    int  decoded_y = -1;    // src_row に入っている元画像の行
+    bool row_ready = false;
+    for (int dy = y0; dy < y1; ++dy) {
+        const int sy = static_cast<int64_t>(dy) * src_h / size.y;
+        if (sy != decoded_y) {
+            // 先頭から順に展開するしかないので、画面外の行も読み飛ばしながら展開する
+            while (decoded_y < sy) {
+                if (!decoder.DecodeRow(src_row, writer.Format())) {
+                    return false;
+                }
+                ++decoded_y;
+            }
+            row_ready = false;
+        }
+
+        // 等倍なら展開した行をそのまま使い、拡大縮小する場合は同じ元画像の行が続く間、変換済みの行を使い回す
+        const uint32_t *row = src_row + x0;
+        if (src_w != size.x) {
+            if (!row_ready) {
+                uint64_t sx = x0 * step_x;
+                for (int dx = x0; dx < x1; ++dx, sx += step_x) {
+                    dst_row[dx - x0] = src_row[sx >> 16];
+                }
+                row_ready = true;
+            }
+            row = dst_row;
+        }
+
+        if (decoder.HasAlpha()) {
+            writer.CompositeSpan(pos.x + x0, pos.y + dy, x1 - x0, row);
+        } else {
+            writer.WriteRow(pos.x + x0, pos.y + dy, x1 - x0, row);
+        }
+    }
+    return true;
+}
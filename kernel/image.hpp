@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "graphics.hpp"
+
+// 展開後の画像(拡大縮小前)の横幅の上限
+const int kMaxImageWidth = 4096;
+
+// QOI形式の画像を pos を左上として size の大きさに拡大縮小(最近傍法)して描画する
+// 画面からはみ出す部分は描画しない。アルファチャンネルを持つ画像は下地に重ねる
+// 画像が壊れている、または大きすぎる場合は false を返す (途中まで描画されることがある)
+bool DrawQoiImage(PixelWriter &writer, const uint8_t *data, size_t data_size, const Vector2D<int> &pos,
+                  const Vector2D<int> &size);
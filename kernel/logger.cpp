@@ -0,0 +1,53 @@
+#include <cstdio>
+
+#include "logger.hpp"
+#include "perf.hpp"
+
+#ifdef HEADLESS
+#define LOG_SINKS_DEFAULT kLogSinkSerial
+#else
+#define LOG_SINKS_DEFAULT kLogSinkAll
+#endif
+
+namespace {
+    Console     *log_console = nullptr;
+    SerialPort  *log_serial  = nullptr;
+    unsigned int log_sinks   = LOG_SINKS_DEFAULT;
+}    // namespace
+
+void SetLogConsole(Console *console)
+{
+    log_console = console;
+}
+
+void SetLogSerial(SerialPort *serial)
+{
+    log_serial = serial;
+}
+
+void SetLogSinks(unsigned int sinks)
+{
+    log_sinks = sinks;
+}
+
+int printk(const char *format, ...)
+{
+    PERF_SCOPE(kPerfPrintk);
+    va_list ap;
+    int     result;
+    char    s[1024];
+
+    va_start(ap, format);
+    result = vsprintf(s, format, ap);
+    va_end(ap);
+
+    // シリアルへは1回のprintkぶんをまとめてFIFO単位で送信する
+    if ((log_sinks & kLogSinkSerial) && log_serial) {
+        log_serial->PutString(s);
+        log_serial->Flush();
+    }
+    if ((log_sinks & kLogSinkScreen) && log_console) {
+        log_console->PutString(s);
+    }
+    return result;
+}
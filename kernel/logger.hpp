@@ -0,0 +1,21 @@
+#pragma once
+
+#include "console.hpp"
+#include "serial.hpp"
+
+// printk の出力先 (ビットの組み合わせで指定する)
+enum LogSink
+{
+    kLogSinkScreen = 1 << 0,    // フレームバッファ上のコンソール
+    kLogSinkSerial = 1 << 1,    // シリアルポート(COM1)
+    kLogSinkAll    = kLogSinkScreen | kLogSinkSerial,
+};
+
+// printk の出力先となるコンソール・シリアルポートを登録する (nullptrなら出力しない)
+void SetLogConsole(Console *console);
+void SetLogSerial(SerialPort *serial);
+// 出力先を切り替える。kLogSinkSerial のみにするとフレームバッファへの描画は一切行わない
+void SetLogSinks(unsigned int sinks);
+
+// 書式付き出力
+int printk(const char *format, ...);
@@ -1,11 +1,17 @@
 #include <cstddef>
 #include <cstdint>
-#include <cstdio>
 
+#include "boot_allocator.hpp"
 #include "console.hpp"
+#include "desktop.hpp"
 #include "font.hpp"
 #include "frame_buffer_config.hpp"
 #include "graphics.hpp"
+#include "logger.hpp"
+#include "memory_map.hpp"
+#include "perf.hpp"
+#include "serial.hpp"
+#include "test_mode.hpp"
 
 // 配置new :
 // メモリの確保は行わないが、指定したメモリ(buf)上にインスタンスを作成する
@@ -22,85 +28,94 @@ extern "C" void __cxa_pure_virtual()
         __asm__("hlt");
 }
 
-const PixelColor kDesktopBGColor{45, 118, 237};
-const PixelColor kDesktopFGColor{255, 255, 255};
-
-const int  kMouseCursorWidth                                             = 15;
-const int  kMouseCursorHeight                                            = 24;
-const char mouse_cursor_shape[kMouseCursorHeight][kMouseCursorWidth + 1] = {
-    "@              ", "@@             ", "@.@            ", "@..@           ", "@...@          ", "@....@         ",
-    "@.....@        ", "@......@       ", "@.......@      ", "@........@     ", "@.........@    ", "@..........@   ",
-    "@...........@  ", "@............@ ", "@......@@@@@@@@", "@......@       ", "@....@@.@      ", "@...@ @.@      ",
-    "@..@   @.@     ", "@.@    @.@     ", "@@      @.@    ", "@       @.@    ", "         @.@   ", "         @@@   ",
-};
-
 // ピクセル描画クラスのメモリ確保
 // (配列によるメモリ確保は言語に元々備わっているため利用できる)
-char         pixel_writer_buf[sizeof(RGBResv8BitPerColorPixelWriter)];
+char         pixel_writer_buf[kPixelWriterSize];
 PixelWriter *pixel_writer;
 
 // コンソール用のメモリ確保
-char     console_buf[sizeof(Console)];
-Console *console;
-
-int printk(const char *format, ...)
+// カーネルログ、デバッグ出力、状態表示の3つのコンソールを用意し、1つだけを画面に表示する
+enum ConsoleId
 {
-    va_list ap;
-    int     result;
-    char    s[1024];
+    kConsoleLog,
+    kConsoleDebug,
+    kConsoleStatus,
+    kNumConsoles,
+};
+// 各コンソールのサーフェスは画面の大きさで決まり、4K画面の4倍表示では1枚16MBになるため、
+// 固定アドレスに置かれるカーネルの.bssではなく、起動時にメモリマップの空き領域から確保する
+char     console_buf[kNumConsoles][sizeof(Console)];
+Console *consoles[kNumConsoles];
 
-    va_start(ap, format);
-    result = vsprintf(s, format, ap);
-    va_end(ap);
+// 表示するコンソールを切り替える (サーフェスを画面へ転送するだけで、文字の描き直しは行わない)
+void SwitchConsole(ConsoleId id)
+{
+    consoles[id]->Activate();
+}
 
-    console->PutString(s);
-    return result;
-};
+// シリアルポート用のメモリ確保
+char        serial_buf[sizeof(SerialPort)];
+SerialPort *serial;
 
 // C++独自の参照渡し(参照型)で関数を定義しているが、C言語から呼び出す場合は
 // ポインタを指定すればOK. (System V AMD64 ABI(コンパイラ)の仕様で決まっている)
 // ABI = プログラム(関数など=呼出規約, Calling
 // Convention)が動作するにあたり、必要なレジスタやメモリの使い方を定義したもの
 // コンパイラはこのABIに従って機械語を生成する。
-extern "C" void KernelMain(const FrameBufferConfig &frame_buffer_config)
+extern "C" void KernelMain(const FrameBufferConfig &frame_buffer_config, const MemoryMap &memory_map)
 {
-    // ピクセルの形式で描画クラスを変更する (ポリモフィズム)
-    switch (frame_buffer_config.pixel_format) {
-        case kPixelRGBResv8BitPerColor:
-            // OSの機能が使えないため？C++のコンストラクタ呼び出しができない
-            // (通常のnewも同様) そのため配置newを利用
-            pixel_writer = new (pixel_writer_buf) RGBResv8BitPerColorPixelWriter{frame_buffer_config};
-            break;
-        case kPixelBGRResv8BitPerColor:
-            pixel_writer = new (pixel_writer_buf) BGRResv8BitPerColorPixelWriter{frame_buffer_config};
-            break;
+    // ログをシリアルにも出すため、描画より先に初期化しておく
+    serial = new (serial_buf) SerialPort{SerialPort::kCOM1};
+    if (serial->Initialize()) {
+        SetLogSerial(serial);
     }
 
-    const int kFrameWidth  = frame_buffer_config.horizontal_resolution;
+    // ピクセルの形式に合った描画クラスを作る
+    // OSの機能が使えないため？C++のコンストラクタ呼び出しができない
+    // (通常のnewも同様) そのため配置newを利用
+    pixel_writer = NewPixelWriter(pixel_writer_buf, frame_buffer_config);
+
     const int kFrameHeight = frame_buffer_config.vertical_resolution;
 
-    // 背景の描画
-    FillRectangle(*pixel_writer, {0, 0}, {kFrameWidth, kFrameHeight - 50}, kDesktopBGColor);
-    FillRectangle(*pixel_writer, {0, kFrameHeight - 50}, {kFrameWidth, 50}, {1, 8, 17});
-    FillRectangle(*pixel_writer, {0, kFrameHeight - 50}, {kFrameWidth / 5, 50}, {80, 80, 80});
-    DrawRectangle(*pixel_writer, {10, kFrameHeight - 40}, {30, 30}, {160, 160, 160});
+    // 背景(壁紙とタスクバー)の描画
+    DrawDesktop(*pixel_writer);
 
     // コンソールクラスの初期化
-    console = new (console_buf) Console{*pixel_writer, kDesktopFGColor, kDesktopBGColor};
+    // 高解像度の画面では 8x16 の文字が小さすぎるため、縦540ピクセルごとに1倍ずつ拡大する (4Kで4倍)
+    int text_scale = kFrameHeight / 540;
+    text_scale     = text_scale < 1 ? 1 : (text_scale > kMaxTextScale ? kMaxTextScale : text_scale);
+    InitializeBootAllocator(memory_map);
+    const size_t surface_pixels = Console::SurfacePixels(*pixel_writer);
+    for (int i = 0; i < kNumConsoles; ++i) {
+        auto *surface = static_cast<uint32_t *>(AllocateBootMemory(sizeof(uint32_t) * surface_pixels, 4096));
+        if (surface == nullptr) {
+            // まだコンソールがないため、シリアルにだけ出力される
+            printk("failed to allocate console surfaces (%lu pixels each)\n", static_cast<unsigned long>(surface_pixels));
+            while (1)
+                __asm__("hlt");
+        }
+        consoles[i] = new (console_buf[i])
+            Console{*pixel_writer, surface, surface_pixels, kDesktopFGColor, kDesktopBGColor, text_scale};
+    }
+    SetLogConsole(consoles[kConsoleLog]);
+
+#ifdef KERNEL_TEST_MODE
+    // 描画テストモード: 各シナリオを実行して結果をシリアルへ出力し、そのまま停止する
+    RunGraphicsTests(*pixel_writer, *serial, *consoles[kConsoleLog]);
+#endif
 
-    // コンソールへの描画
+    SwitchConsole(kConsoleLog);
+
+    // コンソールへの描画 (表示していないコンソールへの出力は画面に触れない)
     printk("Welcome to MikanOS!\n");
+    consoles[kConsoleDebug]->PutString("debug console\n");
+    consoles[kConsoleStatus]->PutString("status console\n");
 
     // マウスカーソルの描画
-    for (int dy = 0; dy < kMouseCursorHeight; ++dy) {
-        for (int dx = 0; dx < kMouseCursorWidth; ++dx) {
-            if (mouse_cursor_shape[dy][dx] == '@') {
-                pixel_writer->Write(200 + dx, 100 + dy, {0, 0, 0});
-            } else if (mouse_cursor_shape[dy][dx] == '.') {
-                pixel_writer->Write(200 + dx, 100 + dy, {255, 255, 255});
-            }
-        }
-    }
+    DrawMouseCursor(*pixel_writer, {200, 100});
+
+    // 計測結果の出力 (PERF=1 でビルドした場合のみ有効)
+    PrintPerfReport();
 
     while (1)
         // アセンブリを直接呼び出した方(インラインアセンブリ)が待機中のCPU使用率を節約できる
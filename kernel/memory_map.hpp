@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+// UEFIのメモリマップ (ローダが ExitBootServices に使ったものを、そのままカーネルに渡す)
+// ローダ(C言語)からも include するため、C言語の範囲で書く
+struct MemoryMap
+{
+    unsigned long long buffer_size;        // 割り当てられたバッファーのサイズ
+    void              *buffer;             // 割り当てられたバッファーの先頭アドレス
+    unsigned long long map_size;           // 得られたメモリマップのサイズ
+    unsigned long long map_key;            // メモリマップの(時系列)識別用ID
+    unsigned long long descriptor_size;    // メモリマップの個々の行を表すディスクリプタのバイト数
+    uint32_t           descriptor_version; // メモリディスクリプタ構造体のバージョン
+};
+
+// メモリマップの1行 (EFI_MEMORY_DESCRIPTOR と同じ配置)
+// 行の間隔は sizeof(MemoryDescriptor) ではなく MemoryMap::descriptor_size を使うこと
+struct MemoryDescriptor
+{
+    uint32_t  type;               // メモリ領域の種別 (MemoryType)
+    uintptr_t physical_start;     // メモリ領域先頭の物理メモリアドレス
+    uintptr_t virtual_start;      // メモリ領域先頭の仮想メモリアドレス
+    uint64_t  number_of_pages;    // メモリ領域の大きさ (kUEFIPageSize 単位)
+    uint64_t  attribute;          // メモリ領域が使える用途を示すビット集合
+};
+
+// メモリ領域の種別 (EFI_MEMORY_TYPE と同じ値)
+enum MemoryType
+{
+    kEfiReservedMemoryType,
+    kEfiLoaderCode,
+    kEfiLoaderData,
+    kEfiBootServicesCode,
+    kEfiBootServicesData,
+    kEfiRuntimeServicesCode,
+    kEfiRuntimeServicesData,
+    kEfiConventionalMemory,
+    kEfiUnusableMemory,
+    kEfiACPIReclaimMemory,
+    kEfiACPIMemoryNVS,
+    kEfiMemoryMappedIO,
+    kEfiMemoryMappedIOPortSpace,
+    kEfiPalCode,
+    kEfiPersistentMemory,
+    kEfiMaxMemoryType,
+};
+
+// メモリマップの1ページの大きさ
+enum
+{
+    kUEFIPageSize = 4096,
+};
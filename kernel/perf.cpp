@@ -0,0 +1,78 @@
+#include <cstring>
+
+#include "logger.hpp"
+#include "perf.hpp"
+
+#ifdef ENABLE_PERF
+namespace {
+    // コンストラクタを持たない配列なので、静的に0初期化される
+    PerfHistogram perf_histograms[kPerfProbeCount];
+
+    const char *const kPerfProbeNames[kPerfProbeCount] = {
+        "PixelWriter::WriteSpan",
+        "FillRectangle",
+        "DrawQoiImage",
+        "WriteUnicode",
+        "PixelWriter::BlendSpan",
+        "PixelWriter::CompositeSpan",
+        "BlendUnicode",
+        "Console::PutString",
+        "Console::Newline",
+        "printk",
+    };
+
+    // 値vの入るバケット番号 (= floor(log2(v)), v=0 はバケット0)
+    int BucketOf(uint64_t v)
+    {
+        return v == 0 ? 0 : 63 - __builtin_clzll(v);
+    }
+
+    // 累積度数が全体の permille/1000 に達するバケットの上限値を返す
+    uint64_t Percentile(const PerfHistogram &h, int permille)
+    {
+        const uint64_t target = (h.count * permille + 999) / 1000;
+        uint64_t       sum    = 0;
+        for (int i = 0; i < PerfHistogram::kBuckets; ++i) {
+            sum += h.buckets[i];
+            if (sum >= target) {
+                const uint64_t upper = i >= 63 ? ~0ull : (2ull << i) - 1;
+                return upper < h.max ? upper : h.max;
+            }
+        }
+        return h.max;
+    }
+}    // namespace
+
+void PerfRecord(PerfProbeId id, uint64_t cycles)
+{
+    PerfHistogram &h = perf_histograms[id];
+    ++h.count;
+    ++h.buckets[BucketOf(cycles)];
+    if (cycles > h.max) {
+        h.max = cycles;
+    }
+}
+
+void PrintPerfReport()
+{
+    // レポート出力自体(printk)の計測が混ざらないよう、先にコピーを取っておく
+    PerfHistogram snapshot[kPerfProbeCount];
+    memcpy(snapshot, perf_histograms, sizeof(snapshot));
+
+    printk("%-28s %10s %10s %10s %10s\n", "probe", "count", "p50", "p99", "max");
+    for (int i = 0; i < kPerfProbeCount; ++i) {
+        const PerfHistogram &h = snapshot[i];
+        if (h.count == 0) {
+            continue;
+        }
+        printk("%-28s %10lu %10lu %10lu %10lu\n", kPerfProbeNames[i], static_cast<unsigned long>(h.count),
+               static_cast<unsigned long>(Percentile(h, 500)), static_cast<unsigned long>(Percentile(h, 990)),
+               static_cast<unsigned long>(h.max));
+    }
+}
+
+void ResetPerfCounters()
+{
+    memset(perf_histograms, 0, sizeof(perf_histograms));
+}
+#endif
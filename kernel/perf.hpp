@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+
+// 計測対象(プローブ)の一覧
+// 新しいプローブを追加する場合は、ここと perf.cpp の kPerfProbeNames の両方に追加する
+enum PerfProbeId
+{
+    kPerfWriteSpan,
+    kPerfFillRectangle,
+    kPerfDrawImage,
+    kPerfWriteGlyph,
+    kPerfBlendSpan,
+    kPerfCompositeSpan,
+    kPerfBlendGlyph,
+    kPerfConsolePutString,
+    kPerfConsoleNewline,
+    kPerfPrintk,
+    kPerfProbeCount,
+};
+
+// RDTSCで計測したサイクル数を記録するヒストグラム
+// バケットiには [2^i, 2^(i+1)) サイクルの計測値が入る (log2バケット)
+struct PerfHistogram
+{
+    static const int kBuckets = 64;
+
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[kBuckets];
+};
+
+// TSCの読み出し (計測プローブのほか、テストモードのシナリオ計測でも使う)
+// 計測開始用: lfenceで先行命令の完了を待ってからTSCを読む
+inline uint64_t PerfReadStart()
+{
+    uint32_t lo, hi;
+    __asm__ volatile("lfence\n\trdtsc" : "=a"(lo), "=d"(hi)::"memory");
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+// 計測終了用: rdtscpは先行命令の完了を待ってからTSCを読む
+inline uint64_t PerfReadEnd()
+{
+    uint32_t lo, hi, aux;
+    __asm__ volatile("rdtscp" : "=a"(lo), "=d"(hi), "=c"(aux)::"memory");
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+#ifdef ENABLE_PERF
+
+void PerfRecord(PerfProbeId id, uint64_t cycles);
+
+// スコープを抜けるまでのサイクル数を計測して、プローブのヒストグラムに記録するクラス (RAII)
+class PerfScope {
+  public:
+    explicit PerfScope(PerfProbeId id) : id_{id}, start_{PerfReadStart()} {}
+    ~PerfScope() { PerfRecord(id_, PerfReadEnd() - start_); }
+
+  private:
+    const PerfProbeId id_;
+    const uint64_t    start_;
+};
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b)  PERF_CONCAT_(a, b)
+#define PERF_SCOPE(id)     PerfScope PERF_CONCAT(perf_scope_, __LINE__){id}
+
+// 全プローブの 回数, p50, p99, 最大値 をprintkで出力する
+// (p50, p99 はバケットの上限値で近似する)
+void PrintPerfReport();
+// 全プローブの記録をクリアする
+void ResetPerfCounters();
+
+#else
+
+// 計測を無効にしたビルドでは何も生成しない
+#define PERF_SCOPE(id) \
+    do {               \
+    } while (0)
+
+inline void PrintPerfReport() {}
+inline void ResetPerfCounters() {}
+
+#endif
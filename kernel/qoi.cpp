@@ -0,0 +1,109 @@
+#include "qoi.hpp"
+
+namespace {
+    const int kHeaderSize  = 14;
+    const int kPaddingSize = 8;    // 終端マーカ (0x00 x 7, 0x01)
+
+    const uint8_t kOpIndex = 0x00;    // 0b00xxxxxx
+    const uint8_t kOpDiff  = 0x40;    // 0b01xxxxxx
+    const uint8_t kOpLuma  = 0x80;    // 0b10xxxxxx
+    const uint8_t kOpRGB   = 0xfe;
+    const uint8_t kOpRGBA  = 0xff;
+    const uint8_t kMask2   = 0xc0;
+
+    uint32_t ReadBE32(const uint8_t *p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+    }
+}    // namespace
+
+QoiDecoder::QoiDecoder()
+    : pos_{nullptr}, end_{nullptr}, width_{0}, height_{0}, rows_decoded_{0}, has_alpha_{false}, px_{0, 0, 0, 255},
+      index_{}, run_{0}
+{
+}
+
+bool QoiDecoder::Open(const uint8_t *data, size_t size)
+{
+    if (size < kHeaderSize + kPaddingSize || data[0] != 'q' || data[1] != 'o' || data[2] != 'i' || data[3] != 'f') {
+        return false;
+    }
+    width_  = ReadBE32(data + 4);
+    height_ = ReadBE32(data + 8);
+    if (width_ == 0 || height_ == 0 || (data[12] != 3 && data[12] != 4)) {
+        return false;
+    }
+
+    has_alpha_    = data[12] == 4;
+    pos_          = data + kHeaderSize;
+    end_          = data + size - kPaddingSize;
+    rows_decoded_ = 0;
+    px_           = {0, 0, 0, 255};
+    run_          = 0;
+    for (auto &c : index_) {
+        c = {0, 0, 0, 0};
+    }
+    return true;
+}
+
+bool QoiDecoder::DecodeRow(uint32_t *out, PixelFormat format)
+{
+    if (pos_ == nullptr || rows_decoded_ >= height_) {
+        return false;
+    }
+
+    // 赤と青の位置だけがピクセル形式で異なる
+    const int r_shift = format == kPixelRGBResv8BitPerColor ? 0 : 16;
+    const int b_shift = 16 - r_shift;
+
+    uint32_t packed = 0;
+    bool     dirty  = true;    // px_ が変わり、packed を作り直す必要があるか
+    for (uint32_t x = 0; x < width_; ++x) {
+        if (run_ > 0) {
+            --run_;
+        } else {
+            if (pos_ >= end_) {
+                pos_ = nullptr;
+                return false;
+            }
+            const uint8_t b1 = *pos_++;
+            if (b1 == kOpRGB) {
+                px_.r = pos_[0], px_.g = pos_[1], px_.b = pos_[2];
+                pos_ += 3;
+            } else if (b1 == kOpRGBA) {
+                px_.r = pos_[0], px_.g = pos_[1], px_.b = pos_[2], px_.a = pos_[3];
+                pos_ += 4;
+            } else if ((b1 & kMask2) == kOpIndex) {
+                px_ = index_[b1];
+            } else if ((b1 & kMask2) == kOpDiff) {
+                px_.r += ((b1 >> 4) & 0x03) - 2;
+                px_.g += ((b1 >> 2) & 0x03) - 2;
+                px_.b += (b1 & 0x03) - 2;
+            } else if ((b1 & kMask2) == kOpLuma) {
+                const uint8_t b2 = *pos_++;
+                const int     vg = (b1 & 0x3f) - 32;
+                px_.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                px_.g += vg;
+                px_.b += vg - 8 + (b2 & 0x0f);
+            } else {
+                // 0b11xxxxxx (RUN): この画素を含めて (下位6bit + 1) 回繰り返す。行をまたぐこともある
+                run_ = b1 & 0x3f;
+            }
+            index_[(px_.r * 3 + px_.g * 5 + px_.b * 7 + px_.a * 11) % 64] = px_;
+            dirty = true;
+        }
+
+        if (dirty) {
+            uint32_t r = px_.r, g = px_.g, b = px_.b;
+            if (px_.a != 255) {
+                r = (r * px_.a + 127) / 255, g = (g * px_.a + 127) / 255, b = (b * px_.a + 127) / 255;
+            }
+            packed = (r << r_shift) | (g << 8) | (b << b_shift) | (uint32_t(px_.a) << 24);
+            dirty  = false;
+        }
+        out[x] = packed;
+    }
+
+    ++rows_decoded_;
+    return true;
+}
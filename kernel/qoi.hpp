@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "frame_buffer_config.hpp"
+
+// QOI (Quite OK Image) 形式の画像を1行ずつ展開するデコーダ
+// 画像全体を展開したバッファは作らず、呼び出し側が用意した1行ぶんのバッファへ
+// フレームバッファと同じピクセル形式で直接書き出す
+// (カーネル外のツールからも使えるよう、frame_buffer_config.hpp 以外に依存しない)
+class QoiDecoder {
+  public:
+    QoiDecoder();
+    // ヘッダを読み、正しいQOI形式なら true を返す
+    bool Open(const uint8_t *data, size_t size);
+
+    uint32_t Width() const { return width_; }
+    uint32_t Height() const { return height_; }
+    // アルファチャンネルを持つ(channels == 4)か
+    bool HasAlpha() const { return has_alpha_; }
+
+    // 次の1行(Width()ピクセル)を format の形式で out に書き出す
+    // 4バイト目にはアルファ値を入れ、色はアルファを乗算済みにする (PixelWriter::CompositeSpan の形式)
+    // 全ての行を読み終えている場合や、データが壊れている場合は false を返す
+    bool DecodeRow(uint32_t *out, PixelFormat format);
+
+  private:
+    struct Rgba
+    {
+        uint8_t r, g, b, a;
+    };
+
+    const uint8_t *pos_, *end_;
+    uint32_t       width_, height_, rows_decoded_;
+    bool           has_alpha_;
+    Rgba           px_;
+    Rgba           index_[64];
+    int            run_;
+};
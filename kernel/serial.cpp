@@ -0,0 +1,106 @@
+#include "serial.hpp"
+
+namespace {
+    // UARTのレジスタ (ポートのベースアドレスからのオフセット)
+    const uint16_t kData         = 0;    // 送受信データ (DLAB=1 のときは分周値の下位バイト)
+    const uint16_t kIntEnable    = 1;    // 割り込み許可 (DLAB=1 のときは分周値の上位バイト)
+    const uint16_t kFifoControl  = 2;
+    const uint16_t kLineControl  = 3;
+    const uint16_t kModemControl = 4;
+    const uint16_t kLineStatus   = 5;
+
+    const uint8_t kLineStatusDR   = 0x01;    // 受信データあり
+    const uint8_t kLineStatusTHRE = 0x20;    // 送信保持レジスタ(FIFO有効時は送信FIFO)が空
+
+    void IoOut8(uint16_t port, uint8_t value)
+    {
+        __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
+    }
+
+    uint8_t IoIn8(uint16_t port)
+    {
+        uint8_t value;
+        __asm__ volatile("inb %1, %0" : "=a"(value) : "Nd"(port));
+        return value;
+    }
+}    // namespace
+
+SerialPort::SerialPort(uint16_t port) : port_{port}, present_{false}, buffer_{}, buffered_{0} {}
+
+bool SerialPort::Initialize()
+{
+    IoOut8(port_ + kIntEnable, 0x00);      // 割り込みは使わない (ポーリング)
+    IoOut8(port_ + kLineControl, 0x80);    // DLAB=1: 分周値の設定モード
+    IoOut8(port_ + kData, 0x01);           // 115200 / 1 = 115200bps
+    IoOut8(port_ + kIntEnable, 0x00);
+    IoOut8(port_ + kLineControl, 0x03);    // DLAB=0, 8bit, パリティなし, ストップビット1
+    IoOut8(port_ + kFifoControl, 0xc7);    // FIFO有効 + 送受信FIFOクリア, 受信トリガ14バイト
+
+    // ループバックモードで書いた値が読めるかを確認し、UARTの存在をチェックする
+    IoOut8(port_ + kModemControl, 0x1e);
+    IoOut8(port_ + kData, 0xae);
+    if (IoIn8(port_ + kData) != 0xae) {
+        present_ = false;
+        return false;
+    }
+
+    IoOut8(port_ + kModemControl, 0x0f);    // 通常モード (DTR, RTS, OUT1, OUT2)
+    present_ = true;
+    return true;
+}
+
+void SerialPort::PutString(const char *s)
+{
+    while (*s) {
+        if (*s == '\n') {
+            Put('\r');
+        }
+        Put(*s);
+        ++s;
+    }
+}
+
+void SerialPort::Put(char c)
+{
+    if (buffered_ == kBufferSize) {
+        Flush();
+    }
+    buffer_[buffered_++] = c;
+}
+
+void SerialPort::Flush()
+{
+    if (!present_) {
+        buffered_ = 0;
+        return;
+    }
+
+    // 1バイトごとにポーリングせず、FIFOが空になったらFIFOの段数分まとめて書き込む
+    for (int sent = 0; sent < buffered_;) {
+        WaitTransmitEmpty();
+        const int burst = buffered_ - sent < kFifoSize ? buffered_ - sent : kFifoSize;
+        for (int i = 0; i < burst; ++i) {
+            IoOut8(port_ + kData, buffer_[sent + i]);
+        }
+        sent += burst;
+    }
+    buffered_ = 0;
+}
+
+void SerialPort::WaitTransmitEmpty()
+{
+    while ((IoIn8(port_ + kLineStatus) & kLineStatusTHRE) == 0) {
+        __asm__ volatile("pause");
+    }
+}
+
+int SerialPort::ReadByte()
+{
+    if (!present_) {
+        return -1;
+    }
+    while ((IoIn8(port_ + kLineStatus) & kLineStatusDR) == 0) {
+        __asm__ volatile("pause");
+    }
+    return IoIn8(port_ + kData);
+}
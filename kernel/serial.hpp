@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 16550互換UART(シリアルポート)への出力クラス
+// 書き込みは一旦内部バッファに溜めて、送信FIFOが空になるのを1回待つごとに最大16バイトをまとめて送る
+class SerialPort {
+  public:
+    static const uint16_t kCOM1       = 0x3f8;
+    static const int      kFifoSize   = 16;     // 16550の送信FIFOの段数
+    static const int      kBufferSize = 256;
+
+    explicit SerialPort(uint16_t port);
+    // 115200bps, 8N1, FIFO有効で初期化する。UARTが見つからなければ false を返し、以降の出力は捨てる
+    bool Initialize();
+    // 改行(\n)は端末向けに\r\nへ変換してバッファに追加する (バッファが一杯になれば送信する)
+    void PutString(const char *s);
+    // バッファに残っている内容を全て送信する
+    void Flush();
+    // 1バイト受信するまで待って返す (ポーリング)。UARTがなければ -1 を返す
+    int ReadByte();
+
+  private:
+    void Put(char c);
+    void WaitTransmitEmpty();
+
+    const uint16_t port_;
+    bool           present_;
+    char           buffer_[kBufferSize];
+    int            buffered_;
+};
@@ -0,0 +1,147 @@
+#include <cstdio>
+
+#include "desktop.hpp"
+#include "font.hpp"
+#include "perf.hpp"
+#include "test_mode.hpp"
+
+namespace {
+    // コンソールに流し込む行数
+    const int kFloodLines = 10000;
+    // マウスカーソルを動かす回数
+    const int kCursorMoves = 2000;
+
+    struct Scenario
+    {
+        const char *name;
+        void (*setup)(PixelWriter &writer, Console &console);    // 計測しない準備 (nullptrなら何もしない)
+        void (*run)(PixelWriter &writer, Console &console);      // 計測する処理
+        int runs;                                                 // 計測の回数 (2回目以降も同じ画面になるものだけ複数回)
+    };
+
+    // 壁紙の展開・拡大とタスクバーの描画
+    void RunDesktop(PixelWriter &writer, Console &console)
+    {
+        DrawDesktop(writer);
+    }
+
+    // 壁紙の上に、縁が半透明のロゴ(CompositeSpan)と被覆率つきの文字(BlendSpan)を敷き詰める
+    void SetupBlendOverlay(PixelWriter &writer, Console &console)
+    {
+        DrawDesktop(writer);
+    }
+
+    void RunBlendOverlay(PixelWriter &writer, Console &console)
+    {
+        const int bottom = writer.Height() - 50;    // タスクバーには重ねない
+        for (int y = 8; y + kLogoSize + 2 + kFontHeight <= bottom; y += 56) {
+            for (int x = 8; x + kLogoSize <= writer.Width(); x += 96) {
+                DrawLogo(writer, {x, y});
+            }
+            BlendString(writer, 8, y + kLogoSize + 2, "Blended text over the wallpaper: 0123456789 ABCDEFGHIJKLMN",
+                        kDesktopFGColor);
+        }
+    }
+
+    // コンソールを表示してから、スクロールが続くように大量の行を書き込む
+    void SetupConsoleFlood(PixelWriter &writer, Console &console)
+    {
+        console.Activate();
+    }
+
+    void RunConsoleFlood(PixelWriter &writer, Console &console)
+    {
+        char line[96];
+        for (int i = 0; i < kFloodLines; ++i) {
+            sprintf(line, "%05d: The quick brown fox jumps over the lazy dog. 0123456789\n", i);
+            console.PutString(line);
+        }
+    }
+
+    // 単色の背景の上でカーソルを動かす (前の位置を背景色で消してから新しい位置に描く)
+    void SetupCursorMoves(PixelWriter &writer, Console &console)
+    {
+        FillRectangle(writer, {0, 0}, {writer.Width(), writer.Height()}, kDesktopBGColor);
+    }
+
+    void RunCursorMoves(PixelWriter &writer, Console &console)
+    {
+        const int range_x = writer.Width() - kMouseCursorWidth;
+        const int range_y = writer.Height() - kMouseCursorHeight;
+        if (range_x <= 0 || range_y <= 0) {
+            return;
+        }
+
+        // 画面の端で跳ね返りながら斜めに動かす (毎回同じ軌跡になる)
+        Vector2D<int> pos{0, 0}, step{7, 5};
+        DrawMouseCursor(writer, pos);
+        for (int i = 0; i < kCursorMoves; ++i) {
+            Vector2D<int> next{pos.x + step.x, pos.y + step.y};
+            if (next.x < 0 || next.x > range_x) {
+                step.x = -step.x;
+                next.x = pos.x + step.x;
+            }
+            if (next.y < 0 || next.y > range_y) {
+                step.y = -step.y;
+                next.y = pos.y + step.y;
+            }
+            FillRectangle(writer, pos, {kMouseCursorWidth, kMouseCursorHeight}, kDesktopBGColor);
+            DrawMouseCursor(writer, next);
+            pos = next;
+        }
+    }
+
+    const Scenario kScenarios[] = {
+        {"desktop", nullptr, RunDesktop, 5},
+        {"blend_overlay", SetupBlendOverlay, RunBlendOverlay, 1},
+        {"console_flood", SetupConsoleFlood, RunConsoleFlood, 1},
+        {"cursor_moves", SetupCursorMoves, RunCursorMoves, 1},
+    };
+
+    // シリアルへ1行出力して、すぐに送信する
+    void Report(SerialPort &serial, const char *line)
+    {
+        serial.PutString(line);
+        serial.Flush();
+    }
+}    // namespace
+
+void RunGraphicsTests(PixelWriter &writer, SerialPort &serial, Console &console)
+{
+    char line[128];
+    sprintf(line, "FBTEST BEGIN %dx%d\n", writer.Width(), writer.Height());
+    Report(serial, line);
+
+    for (const Scenario &s : kScenarios) {
+        if (s.setup != nullptr) {
+            s.setup(writer, console);
+        }
+        ResetPerfCounters();
+
+        uint64_t min = ~0ull, max = 0, sum = 0;
+        for (int i = 0; i < s.runs; ++i) {
+            const uint64_t start  = PerfReadStart();
+            s.run(writer, console);
+            const uint64_t cycles = PerfReadEnd() - start;
+            min = cycles < min ? cycles : min;
+            max = cycles > max ? cycles : max;
+            sum += cycles;
+        }
+
+        sprintf(line, "FBTEST SCENARIO %s runs=%d min=%lu avg=%lu max=%lu\n", s.name, s.runs,
+                static_cast<unsigned long>(min), static_cast<unsigned long>(sum / s.runs),
+                static_cast<unsigned long>(max));
+        Report(serial, line);
+        // プローブ別の内訳 (PERF=1 の場合のみ。HEADLESS なのでシリアルにだけ出力され、画面には影響しない)
+        PrintPerfReport();
+
+        // 画面を取り込み終えるまで次のシナリオに進まない
+        sprintf(line, "FBTEST CAPTURE %s\n", s.name);
+        Report(serial, line);
+        serial.ReadByte();
+    }
+
+    Report(serial, "FBTEST END\n");
+    while (1)
+        __asm__("hlt");
+}
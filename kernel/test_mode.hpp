@@ -0,0 +1,17 @@
+#pragma once
+
+#include "console.hpp"
+#include "graphics.hpp"
+#include "serial.hpp"
+
+// 描画テストモード (make TEST_MODE=1 でビルドした場合のみ KernelMain から呼ばれる)
+//
+// 描画のシナリオを順に実行し、かかったサイクル数をシリアルへ出力する。
+// シナリオごとに画面の取り込みを要求し、ホスト側(tools/fbtest.py)から1バイト受け取るまで待つ。
+// 出力の形式 (1行1レコード):
+//   FBTEST BEGIN <幅>x<高さ>
+//   FBTEST SCENARIO <名前> runs=<回数> min=<最小> avg=<平均> max=<最大>
+//   FBTEST CAPTURE <名前>
+//   FBTEST END
+// 全シナリオの実行後は停止し、戻らない
+[[noreturn]] void RunGraphicsTests(PixelWriter &writer, SerialPort &serial, Console &console);
@@ -0,0 +1,314 @@
+#!/usr/bin/python3
+"""描画テストモードのカーネル (make TEST_MODE=1) を QEMU + OVMF で画面なしで起動し、
+シナリオごとのサイクル数と、フレームバッファの取り込み結果のゴールデン画像との比較を1つのレポートにまとめる
+
+    python tools/fbtest.py --loader Loader.efi --kernel kernel/kernel.elf \\
+        --ovmf-code OVMF_CODE.fd --ovmf-vars OVMF_VARS.fd --golden fbtest_golden
+
+カーネルとの約束事は kernel/test_mode.hpp を参照。ゴールデン画像は解像度ごとに
+<golden>/<シナリオ名>-<幅>x<高さ>.ppm として置き、--update-golden で今回の取り込み結果に置き換える。
+サイクル数は KVM なし (TCG) ではエミュレーションの速さに引きずられるため、比較には --kvm を使うこと
+"""
+
+import argparse
+import json
+import os
+import re
+import selectors
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+
+RECORD_PATTERN = re.compile(r'FBTEST (\w+)(?: (.*))?$')
+# OVMF がシリアルへ出す端末制御シーケンス
+ANSI_ESCAPE = re.compile(r'\x1b\[[0-9;?]*[A-Za-z]')
+
+
+def read_ppm(path: str):
+    """P6 (8bit) の PPM を読み、(幅, 高さ, RGBのバイト列) を返す"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    fields = []
+    pos = 0
+    while len(fields) < 4:
+        while data[pos:pos + 1].isspace():
+            pos += 1
+        if data[pos:pos + 1] == b'#':
+            pos = data.index(b'\n', pos)
+            continue
+        start = pos
+        while not data[pos:pos + 1].isspace():
+            pos += 1
+        fields.append(data[start:pos])
+    if fields[0] != b'P6' or fields[3] != b'255':
+        raise ValueError(f'{path}: not an 8-bit P6 PPM')
+    width, height = int(fields[1]), int(fields[2])
+    pixels = data[pos + 1:pos + 1 + width * height * 3]
+    if len(pixels) != width * height * 3:
+        raise ValueError(f'{path}: truncated')
+    return width, height, pixels
+
+
+def write_ppm(path: str, width: int, height: int, pixels: bytes):
+    with open(path, 'wb') as f:
+        f.write(b'P6\n%d %d\n255\n' % (width, height))
+        f.write(pixels)
+
+
+def compare_images(actual_path: str, golden_path: str, diff_path: str):
+    """一致しないピクセルの数と、その範囲 (x0, y0, x1, y1) を返す
+    一致しないピクセルがあれば、そこを赤く塗った画像を diff_path に書き出す"""
+    aw, ah, actual = read_ppm(actual_path)
+    gw, gh, golden = read_ppm(golden_path)
+    if (aw, ah) != (gw, gh):
+        raise ValueError(f'size mismatch: {aw}x{ah} vs golden {gw}x{gh}')
+    if actual == golden:
+        return 0, None
+
+    diff = bytearray(actual)
+    mismatches = 0
+    x0, y0, x1, y1 = aw, ah, -1, -1
+    for i in range(0, len(actual), 3):
+        if actual[i:i + 3] != golden[i:i + 3]:
+            mismatches += 1
+            x, y = (i // 3) % aw, (i // 3) // aw
+            x0, y0, x1, y1 = min(x0, x), min(y0, y), max(x1, x), max(y1, y)
+            diff[i:i + 3] = b'\xff\x00\x00'
+    write_ppm(diff_path, aw, ah, bytes(diff))
+    return mismatches, (x0, y0, x1, y1)
+
+
+class Monitor:
+    """QEMU の HMP モニタ (UNIX ソケット) でコマンドを送る"""
+
+    PROMPT = b'(qemu) '
+
+    def __init__(self, path: str, timeout: float):
+        deadline = time.monotonic() + timeout
+        while True:
+            try:
+                self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                self.sock.connect(path)
+                break
+            except (FileNotFoundError, ConnectionRefusedError):
+                self.sock.close()
+                if time.monotonic() > deadline:
+                    raise
+                time.sleep(0.1)
+        self.sock.settimeout(timeout)
+        self._read_prompt()
+
+    def _read_prompt(self):
+        data = b''
+        while not data.endswith(self.PROMPT):
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError('QEMU monitor closed')
+            data += chunk
+        return data
+
+    def command(self, line: str):
+        self.sock.sendall(line.encode() + b'\n')
+        return self._read_prompt()
+
+    def close(self):
+        self.sock.close()
+
+
+def build_boot_dir(boot_dir: str, loader: str, kernel: str):
+    """OVMF が起動できる形 (\\EFI\\BOOT\\BOOTX64.EFI と \\kernel.elf) のディレクトリを作る"""
+    efi_dir = os.path.join(boot_dir, 'EFI', 'BOOT')
+    os.makedirs(efi_dir)
+    shutil.copy(loader, os.path.join(efi_dir, 'BOOTX64.EFI'))
+    shutil.copy(kernel, os.path.join(boot_dir, 'kernel.elf'))
+
+
+def qemu_command(ns, work_dir: str, boot_dir: str, monitor_path: str):
+    # OVMF の変数領域は書き換えられるため、コピーを渡す
+    vars_copy = os.path.join(work_dir, 'OVMF_VARS.fd')
+    shutil.copy(ns.ovmf_vars, vars_copy)
+    cmd = [
+        ns.qemu,
+        '-m', ns.memory,
+        '-drive', f'if=pflash,format=raw,readonly=on,file={ns.ovmf_code}',
+        '-drive', f'if=pflash,format=raw,file={vars_copy}',
+        '-drive', f'format=raw,file=fat:rw:{boot_dir}',
+        '-display', 'none',
+        '-chardev', 'stdio,id=com1,signal=off',
+        '-serial', 'chardev:com1',
+        '-monitor', f'unix:{monitor_path},server,nowait',
+        '-no-reboot',
+    ]
+    if ns.kvm:
+        cmd += ['-enable-kvm', '-cpu', 'host']
+    return cmd
+
+
+def run_tests(ns, work_dir: str):
+    """QEMU を起動してシナリオを最後まで実行し、シナリオごとの結果のリストを返す"""
+    boot_dir = os.path.join(work_dir, 'boot')
+    build_boot_dir(boot_dir, ns.loader, ns.kernel)
+    monitor_path = os.path.join(work_dir, 'monitor.sock')
+
+    qemu = subprocess.Popen(qemu_command(ns, work_dir, boot_dir, monitor_path),
+                            stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+    monitor = None
+    results = []
+    resolution = None
+    log = open(os.path.join(ns.output, 'serial.log'), 'w')
+    try:
+        monitor = Monitor(monitor_path, ns.timeout)
+        selector = selectors.DefaultSelector()
+        selector.register(qemu.stdout, selectors.EVENT_READ)
+        deadline = time.monotonic() + ns.timeout
+        pending = b''
+        current = None
+        finished = False
+        while not finished:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                raise TimeoutError(f'no FBTEST END within {ns.timeout} seconds')
+            if not selector.select(remaining):
+                continue
+            chunk = os.read(qemu.stdout.fileno(), 4096)
+            if not chunk:
+                raise ConnectionError(f'QEMU exited (status {qemu.poll()}) before FBTEST END')
+            pending += chunk
+            *lines, pending = pending.split(b'\n')
+            for raw in lines:
+                line = ANSI_ESCAPE.sub('', raw.decode(errors='replace')).rstrip('\r')
+                log.write(line + '\n')
+                m = RECORD_PATTERN.search(line)
+                if not m:
+                    # PERF=1 のカーネルならプローブ別の内訳がここに来る
+                    if current is not None and line.strip():
+                        current.setdefault('probes', []).append(line)
+                    continue
+                kind, args = m.group(1), m.group(2) or ''
+                if kind == 'BEGIN':
+                    resolution = args.strip()
+                elif kind == 'SCENARIO':
+                    name, *fields = args.split()
+                    current = {'name': name}
+                    for field in fields:
+                        key, value = field.split('=', 1)
+                        current[key] = int(value)
+                    results.append(current)
+                elif kind == 'CAPTURE':
+                    name = args.strip()
+                    path = os.path.join(ns.output, f'{name}-{resolution}.ppm')
+                    monitor.command(f'screendump {path}')
+                    # 取り込みが終わってから次のシナリオに進ませる
+                    qemu.stdin.write(b'c')
+                    qemu.stdin.flush()
+                    next(r for r in results if r['name'] == name)['capture'] = path
+                    current = None
+                elif kind == 'END':
+                    finished = True
+    finally:
+        log.close()
+        if monitor is not None:
+            try:
+                monitor.command('quit')
+            except (OSError, ConnectionError):
+                pass
+            monitor.close()
+        try:
+            qemu.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            qemu.kill()
+            qemu.wait()
+    return resolution, results
+
+
+def check_golden(ns, resolution: str, results):
+    """取り込んだ画像をゴールデン画像と比べ、各結果に status を付ける。全て一致すれば True"""
+    ok = True
+    for r in results:
+        if 'capture' not in r:
+            r['status'] = 'no-capture'
+            ok = False
+            continue
+        golden = os.path.join(ns.golden, os.path.basename(r['capture']))
+        if ns.update_golden:
+            os.makedirs(ns.golden, exist_ok=True)
+            shutil.copy(r['capture'], golden)
+            r['status'] = 'updated'
+            continue
+        if not os.path.exists(golden):
+            r['status'] = 'no-golden'
+            ok = False
+            continue
+        diff_path = os.path.join(ns.output, f'{r["name"]}-{resolution}.diff.ppm')
+        try:
+            mismatches, bounds = compare_images(r['capture'], golden, diff_path)
+        except ValueError as e:
+            r['status'] = f'error: {e}'
+            ok = False
+            continue
+        r['mismatches'] = mismatches
+        if mismatches <= ns.tolerance:
+            r['status'] = 'ok'
+        else:
+            r['status'] = 'mismatch'
+            r['bounds'] = bounds
+            r['diff'] = diff_path
+            ok = False
+    return ok
+
+
+def print_report(resolution: str, results, out=sys.stdout):
+    print(f'framebuffer: {resolution}', file=out)
+    print(f'{"scenario":<16} {"runs":>4} {"min":>14} {"avg":>14} {"max":>14} {"pixels":>9}  result', file=out)
+    for r in results:
+        pixels = r.get('mismatches', '-')
+        print(f'{r["name"]:<16} {r["runs"]:>4} {r["min"]:>14} {r["avg"]:>14} {r["max"]:>14} {pixels:>9}  '
+              f'{r.get("status", "-")}', file=out)
+        if 'bounds' in r:
+            x0, y0, x1, y1 = r['bounds']
+            print(f'    differs in ({x0}, {y0})-({x1}, {y1}), see {r["diff"]}', file=out)
+        for line in r.get('probes', []):
+            print(f'    {line}', file=out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='run the MikanOS graphics test mode under QEMU')
+    parser.add_argument('--loader', required=True, help='path to Loader.efi')
+    parser.add_argument('--kernel', required=True, help='path to kernel.elf built with TEST_MODE=1')
+    parser.add_argument('--ovmf-code', required=True, help='path to OVMF_CODE.fd')
+    parser.add_argument('--ovmf-vars', required=True, help='path to OVMF_VARS.fd (a copy is used)')
+    parser.add_argument('--qemu', default='qemu-system-x86_64', help='QEMU executable')
+    parser.add_argument('--memory', default='1G', help='guest memory size')
+    parser.add_argument('--kvm', action='store_true', help='use KVM so that cycle counts are meaningful')
+    parser.add_argument('--golden', default='fbtest_golden', help='directory of golden images')
+    parser.add_argument('--update-golden', action='store_true',
+                        help='replace the golden images with this run\'s captures')
+    parser.add_argument('--tolerance', type=int, default=0, help='number of differing pixels to accept')
+    parser.add_argument('--output', default='fbtest_out', help='directory for captures, diffs and logs')
+    parser.add_argument('--json', help='also write the report as JSON to this path')
+    parser.add_argument('--timeout', type=float, default=300, help='seconds to wait for the test run')
+    ns = parser.parse_args()
+
+    os.makedirs(ns.output, exist_ok=True)
+    ns.output = os.path.abspath(ns.output)
+    with tempfile.TemporaryDirectory(prefix='fbtest-') as work_dir:
+        try:
+            resolution, results = run_tests(ns, work_dir)
+        except (OSError, ConnectionError, TimeoutError) as e:
+            print(f'fbtest: {e} (serial output is in {ns.output}/serial.log)', file=sys.stderr)
+            return 2
+
+    ok = check_golden(ns, resolution, results)
+    print_report(resolution, results)
+    if ns.json:
+        with open(ns.json, 'w') as f:
+            json.dump({'resolution': resolution, 'scenarios': results}, f, indent=2)
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
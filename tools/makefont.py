@@ -8,6 +8,21 @@ import sys
 
 
 BITMAP_PATTERN = re.compile(r'([.*@]+)')
+# グリフの見出し行
+#   0xNN    : JIS X 0201 の文字コード (hankaku.txt の形式)
+#   U+XXXX  : Unicode のコードポイント
+HEADER_PATTERN = re.compile(r'^(?:0x([0-9a-fA-F]{2})|U\+([0-9a-fA-F]{4}))\b')
+
+FONT_HEIGHT = 16
+# 全角グリフが収まる最大幅
+MAX_GLYPH_WIDTH = 16
+# 段差の角1つあたりの被覆率と、角を埋めたピクセルの被覆率の上限
+# 上限を255未満にして、元のビットマップで点いていないピクセルが不透明にならないようにする
+# (四方を囲まれた穴が塗りつぶされて、WriteUnicode と形が変わってしまうため)
+AA_CORNER_COVERAGE = 80
+AA_MAX_COVERAGE = 160
+
+Glyph = collections.namedtuple('Glyph', ['code_point', 'width', 'rows'])
 
 
 def compile(src: str) -> bytes:
@@ -26,16 +41,211 @@ def compile(src: str) -> bytes:
     return b''.join(result)
 
 
+def jisx0201_to_unicode(code: int):
+    """JIS X 0201 の文字コードを Unicode に変換する (対応する文字がなければ None)"""
+    if code < 0x80:
+        return code
+    if 0xa1 <= code <= 0xdf:
+        # 半角カタカナ
+        return 0xff61 + (code - 0xa1)
+    return None
+
+
+def parse_glyphs(src: str):
+    """フォントファイルを読み、(コードポイント, 幅, 各行のビット列) のリストを返す"""
+    glyphs = []
+    code_point = None
+    rows = []
+
+    def flush():
+        if code_point is None:
+            return
+        if len(rows) != FONT_HEIGHT:
+            raise ValueError(f'U+{code_point:04X}: expected {FONT_HEIGHT} rows, got {len(rows)}')
+        width = len(rows[0])
+        if width > MAX_GLYPH_WIDTH or any(len(r) != width for r in rows):
+            raise ValueError(f'U+{code_point:04X}: invalid glyph width')
+        glyphs.append(Glyph(code_point, width, rows))
+
+    skip = False
+    for line in src.splitlines():
+        h = HEADER_PATTERN.match(line)
+        if h:
+            flush()
+            code_point, rows = None, []
+            if h.group(1) is not None:
+                code_point = jisx0201_to_unicode(int(h.group(1), 16))
+            else:
+                code_point = int(h.group(2), 16)
+            skip = code_point is None
+            continue
+
+        m = BITMAP_PATTERN.match(line)
+        if m and not skip:
+            rows.append([(0 if x == '.' else 1) for x in m.group(1)])
+    flush()
+
+    return glyphs
+
+
+def row_runs(row):
+    """1行ぶんのビット列から、不透明ピクセルが連続する区間 (開始位置, 長さ) のリストを返す"""
+    runs = []
+    x = 0
+    while x < len(row):
+        if row[x]:
+            start = x
+            while x < len(row) and row[x]:
+                x += 1
+            runs.append((start, x - start))
+        else:
+            x += 1
+    return runs
+
+
+def coverage_rows(rows, antialias: bool):
+    """ビットマップから各ピクセルの被覆率(0-255)を求める
+
+    antialias が真の場合、斜めの段差の角(上下いずれかと左右いずれかが両方とも点いている空白ピクセル)を
+    半透明(最大 AA_MAX_COVERAGE)にして、段差を目立たなくする
+    """
+    height, width = len(rows), len(rows[0])
+
+    def at(x, y):
+        return 0 <= x < width and 0 <= y < height and rows[y][x]
+
+    result = []
+    for y in range(height):
+        line = []
+        for x in range(width):
+            if rows[y][x]:
+                line.append(255)
+                continue
+            corners = 0
+            if antialias:
+                for dx, dy in ((1, -1), (1, 1), (-1, 1), (-1, -1)):
+                    if at(x + dx, y) and at(x, y + dy):
+                        corners += 1
+            line.append(min(AA_MAX_COVERAGE, AA_CORNER_COVERAGE * corners))
+        result.append(line)
+    return result
+
+
+def compile_cpp(glyphs, antialias: bool = True) -> str:
+    """グリフ表を constexpr な C++ の配列として出力する (font.cpp から #include される)"""
+    by_code_point = {}
+    for g in glyphs:
+        by_code_point[g.code_point] = g
+    if ord('?') not in by_code_point:
+        raise ValueError("the font must contain '?' (used for missing glyphs)")
+    ordered = [by_code_point[cp] for cp in sorted(by_code_point)]
+    if len(ordered) > 0x10000:
+        raise ValueError(f'{len(ordered)} glyphs do not fit the uint16_t glyph numbers in kFontPages')
+    glyph_index = {g.code_point: i for i, g in enumerate(ordered)}
+
+    # ランは全グリフぶんを1つの配列に詰め、グリフは自分のランの先頭位置と行ごとの区切りを持つ
+    run_lines = []
+    glyph_lines = []
+    coverage_lines = []
+    num_runs = 0
+    num_coverage = 0
+    for g in ordered:
+        first_run = num_runs
+        if first_run > 0xffff:
+            raise ValueError(f'U+{g.code_point:04X}: run offset {first_run} does not fit FontGlyph::first_run (uint16_t)')
+        row_begin = []
+        for row in g.rows:
+            row_begin.append(num_runs - first_run)
+            for start, length in row_runs(row):
+                run_lines.append(f'{{{start}, {length}}}')
+                num_runs += 1
+        row_begin.append(num_runs - first_run)
+        glyph_lines.append(
+            f'    {{{num_coverage}, {first_run}, {g.width}, {{{", ".join(map(str, row_begin))}}}}},'
+            f'    // U+{g.code_point:04X}')
+
+        # 半透明描画用の被覆率 (1ピクセル1バイト、行優先で詰める)
+        for line in coverage_rows(g.rows, antialias):
+            coverage_lines.append('    ' + ', '.join(map(str, line)) + ',')
+            num_coverage += len(line)
+
+    # コードポイント -> グリフ番号 の2段の表 (上位8bitでページを引き、下位8bitでページ内を引く)
+    # ページ0は全て「グリフなし」を指すページで、グリフのないページは全てここを指す
+    missing = glyph_index[ord('?')]
+    pages = [[missing] * 256]
+    page_index = [0] * 256
+    for cp, i in glyph_index.items():
+        if cp > 0xffff:
+            raise ValueError(f'U+{cp:X}: only the BMP is supported')
+        hi, lo = cp >> 8, cp & 0xff
+        if page_index[hi] == 0:
+            page_index[hi] = len(pages)
+            pages.append([missing] * 256)
+        pages[page_index[hi]][lo] = i
+    # kFontPageIndex は uint8_t なので、ページ0を含めて256ページまでしか指せない
+    if len(pages) > 256:
+        raise ValueError(f'{len(pages)} glyph pages do not fit the uint8_t kFontPageIndex')
+
+    out = []
+    out.append('// このファイルは tools/makefont.py により生成される。直接編集しないこと')
+    out.append('')
+    out.append(f'constexpr int kFontGlyphCount = {len(ordered)};')
+    out.append(f'constexpr uint16_t kFontMissingGlyph = {missing};')
+    out.append('')
+    out.append('constexpr FontRun kFontRuns[] = {')
+    for i in range(0, len(run_lines), 12):
+        out.append('    ' + ', '.join(run_lines[i:i + 12]) + ',')
+    out.append('};')
+    out.append('')
+    out.append('constexpr uint8_t kFontCoverage[] = {')
+    out.extend(coverage_lines)
+    out.append('};')
+    out.append('')
+    out.append('constexpr FontGlyph kFontGlyphs[kFontGlyphCount] = {')
+    out.extend(glyph_lines)
+    out.append('};')
+    out.append('')
+    out.append('constexpr uint8_t kFontPageIndex[256] = {')
+    for i in range(0, 256, 32):
+        out.append('    ' + ', '.join(map(str, page_index[i:i + 32])) + ',')
+    out.append('};')
+    out.append('')
+    out.append(f'constexpr uint16_t kFontPages[{len(pages)}][256] = {{')
+    for page in pages:
+        out.append('    {')
+        for i in range(0, 256, 32):
+            out.append('        ' + ', '.join(map(str, page[i:i + 32])) + ',')
+        out.append('    },')
+    out.append('};')
+    out.append('')
+
+    return '\n'.join(out)
+
+
 def main():
     parser = argparse.ArgumentParser()
-    parser.add_argument('font', help='path to a font file')
+    parser.add_argument('font', nargs='+', help='path to a font file')
     parser.add_argument('-o', help='path to an output file', default='font.out')
+    parser.add_argument('--cpp', action='store_true',
+                        help='output a constexpr C++ glyph table instead of a raw bitmap')
+    parser.add_argument('--no-antialias', action='store_true',
+                        help='emit coverage masks without edge smoothing (0 or 255 only)')
     ns = parser.parse_args()
 
-    with open(ns.o, 'wb') as out, open(ns.font) as font:
-        src = font.read()
-        out.write(compile(src))
+    if ns.cpp:
+        glyphs = []
+        for path in ns.font:
+            with open(path) as font:
+                glyphs.extend(parse_glyphs(font.read()))
+        with open(ns.o, 'w') as out:
+            out.write(compile_cpp(glyphs, not ns.no_antialias))
+        return
+
+    with open(ns.o, 'wb') as out:
+        for path in ns.font:
+            with open(path) as font:
+                out.write(compile(font.read()))
 
 
 if __name__ == '__main__':
-    main()
\ No newline at end of file
+    main()
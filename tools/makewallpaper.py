@@ -0,0 +1,112 @@
+#!/usr/bin/python3
+
+import argparse
+import random
+import struct
+
+
+def encode_qoi(width: int, height: int, pixels, channels: int = 3) -> bytes:
+    """(r, g, b, a) のリストを QOI 形式に変換する"""
+    out = bytearray(b'qoif' + struct.pack('>IIBB', width, height, channels, 0))
+    index = [(0, 0, 0, 0)] * 64
+    prev = (0, 0, 0, 255)
+    run = 0
+
+    for i, px in enumerate(pixels):
+        if px == prev:
+            run += 1
+            if run == 62 or i == len(pixels) - 1:
+                out.append(0xc0 | (run - 1))
+                run = 0
+            continue
+        if run > 0:
+            out.append(0xc0 | (run - 1))
+            run = 0
+
+        h = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64
+        if index[h] == px:
+            out.append(h)
+        else:
+            index[h] = px
+            if px[3] != prev[3]:
+                out += bytes([0xff, *px])
+            else:
+                vr = (px[0] - prev[0] + 128) % 256 - 128
+                vg = (px[1] - prev[1] + 128) % 256 - 128
+                vb = (px[2] - prev[2] + 128) % 256 - 128
+                vg_r, vg_b = vr - vg, vb - vg
+                if -2 <= vr <= 1 and -2 <= vg <= 1 and -2 <= vb <= 1:
+                    out.append(0x40 | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2))
+                elif -32 <= vg <= 31 and -8 <= vg_r <= 7 and -8 <= vg_b <= 7:
+                    out += bytes([0x80 | (vg + 32), (vg_r + 8) << 4 | (vg_b + 8)])
+                else:
+                    out += bytes([0xfe, *px[:3]])
+        prev = px
+
+    out += bytes([0] * 7 + [1])
+    return bytes(out)
+
+
+def gradient(width: int, height: int, noise: int):
+    """デスクトップ背景色(45, 118, 237)から下へ向かって暗くなるグラデーション"""
+    top, bottom = (45, 118, 237), (10, 40, 110)
+    rng = random.Random(0)
+    pixels = []
+    for y in range(height):
+        t = y / max(1, height - 1)
+        base = [round(a + (b - a) * t) for a, b in zip(top, bottom)]
+        for x in range(width):
+            if noise:
+                px = tuple(min(255, max(0, c + rng.randint(-noise, noise))) for c in base)
+            else:
+                px = tuple(base)
+            pixels.append((*px, 255))
+    return pixels
+
+
+def logo(size: int):
+    """タスクバーに置くロゴ (みかん)。縁を半透明にした RGBA 画像で、下地に重ねて描く"""
+    samples = 4
+    cx, cy, r = size / 2, size / 2 + size / 16, size * 0.4
+    # 葉は実の上に乗せた楕円
+    lx, ly, lrx, lry = size * 0.62, size * 0.16, size * 0.18, size * 0.09
+    pixels = []
+    for y in range(size):
+        for x in range(size):
+            fruit = leaf = 0
+            for sy in range(samples):
+                for sx in range(samples):
+                    px, py = x + (sx + 0.5) / samples, y + (sy + 0.5) / samples
+                    if ((px - lx) / lrx) ** 2 + ((py - ly) / lry) ** 2 <= 1:
+                        leaf += 1
+                    elif (px - cx) ** 2 + (py - cy) ** 2 <= r * r:
+                        fruit += 1
+            covered = fruit + leaf
+            if covered == 0:
+                pixels.append((0, 0, 0, 0))
+                continue
+            color = (60, 160, 50) if leaf > fruit else (247, 130, 30)
+            pixels.append((*color, round(255 * covered / samples ** 2)))
+    return pixels
+
+
+def main():
+    parser = argparse.ArgumentParser(description='generate the desktop wallpaper (or the logo) as a QOI image')
+    parser.add_argument('-o', help='path to an output file', default='wallpaper.qoi')
+    parser.add_argument('--width', type=int, default=640)
+    parser.add_argument('--height', type=int, default=400)
+    parser.add_argument('--noise', type=int, default=0,
+                        help='add per-pixel noise of this amplitude (for decoder benchmarks)')
+    parser.add_argument('--logo', type=int, metavar='SIZE',
+                        help='generate the SIZExSIZE taskbar logo with an alpha channel instead')
+    ns = parser.parse_args()
+
+    with open(ns.o, 'wb') as out:
+        if ns.logo:
+            out.write(encode_qoi(ns.logo, ns.logo, logo(ns.logo), channels=4))
+            return
+        out.write(encode_qoi(ns.width, ns.height, gradient(ns.width, ns.height, ns.noise)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,122 @@
+#!/usr/bin/python3
+
+import argparse
+import collections
+import struct
+import sys
+
+
+# MikanLoaderPkg/Main.c の MemoryMapDumpHeader, MemoryMapDumpEntry と同じ形式
+HEADER = struct.Struct('<4sIII')
+ENTRY = struct.Struct('<IIQQQ')
+DUMP_VERSION = 1
+PAGE_SIZE = 4096
+
+MEMORY_TYPES = [
+    'EfiReservedMemoryType',
+    'EfiLoaderCode',
+    'EfiLoaderData',
+    'EfiBootServicesCode',
+    'EfiBootServicesData',
+    'EfiRuntimeServicesCode',
+    'EfiRuntimeServicesData',
+    'EfiConventionalMemory',
+    'EfiUnusableMemory',
+    'EfiACPIReclaimMemory',
+    'EfiACPIMemoryNVS',
+    'EfiMemoryMappedIO',
+    'EfiMemoryMappedIOPortSpace',
+    'EfiPalCode',
+    'EfiPersistentMemory',
+]
+CONVENTIONAL = 7
+# ブートサービス終了後にOSが自由に使える種別
+AVAILABLE_AFTER_EXIT = {1, 2, 3, 4, 7}
+
+Region = collections.namedtuple('Region', ['type', 'start', 'pages', 'attribute'])
+
+
+def type_name(t: int) -> str:
+    return MEMORY_TYPES[t] if t < len(MEMORY_TYPES) else f'InvalidMemoryType({t:#x})'
+
+
+def load(data: bytes):
+    """memmap.bin を読み、Region のリストを返す"""
+    if len(data) < HEADER.size:
+        raise ValueError('file is too short')
+    magic, version, num_entries, entry_size = HEADER.unpack_from(data)
+    if magic != b'MMAP' or version != DUMP_VERSION:
+        raise ValueError('not a memory map dump (bad magic or version)')
+    if entry_size < ENTRY.size or len(data) < HEADER.size + entry_size * num_entries:
+        raise ValueError('truncated memory map dump')
+
+    regions = []
+    for i in range(num_entries):
+        t, _, start, pages, attr = ENTRY.unpack_from(data, HEADER.size + entry_size * i)
+        regions.append(Region(t, start, pages, attr))
+    return regions
+
+
+def largest_run(regions, types):
+    """種別が types に含まれる領域が物理アドレス上で連続する区間のうち、最大のもの (先頭, ページ数) を返す"""
+    best = (0, 0)
+    run_start, run_pages = None, 0
+    for r in sorted(regions, key=lambda r: r.start):
+        if r.type not in types:
+            run_start, run_pages = None, 0
+            continue
+        if run_start is not None and run_start + run_pages * PAGE_SIZE == r.start:
+            run_pages += r.pages
+        else:
+            run_start, run_pages = r.start, r.pages
+        if run_pages > best[1]:
+            best = (run_start, run_pages)
+    return best
+
+
+def mib(pages: int) -> str:
+    return f'{pages * PAGE_SIZE / (1024 * 1024):10.2f} MiB'
+
+
+def summarize(regions, out):
+    pages_by_type = collections.Counter()
+    count_by_type = collections.Counter()
+    for r in regions:
+        pages_by_type[r.type] += r.pages
+        count_by_type[r.type] += 1
+
+    print(f'{len(regions)} descriptors', file=out)
+    print(f'{"type":<28} {"count":>6} {"pages":>10} {"size":>14}', file=out)
+    for t in sorted(pages_by_type):
+        print(f'{type_name(t):<28} {count_by_type[t]:>6} {pages_by_type[t]:>10} {mib(pages_by_type[t])}', file=out)
+
+    free = pages_by_type[CONVENTIONAL]
+    available = sum(pages_by_type[t] for t in AVAILABLE_AFTER_EXIT)
+    print(file=out)
+    print(f'free (conventional):              {mib(free)}', file=out)
+    print(f'available after ExitBootServices: {mib(available)}', file=out)
+    for label, types in (('free', {CONVENTIONAL}), ('available', AVAILABLE_AFTER_EXIT)):
+        start, pages = largest_run(regions, types)
+        print(f'largest contiguous {label + ":":<14} {mib(pages)} at {start:#014x}', file=out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode and summarize a binary memory map dump (memmap.bin)')
+    parser.add_argument('dump', help='path to memmap.bin written by the loader')
+    parser.add_argument('--csv', action='store_true', help='print every descriptor as CSV instead of a summary')
+    ns = parser.parse_args()
+
+    with open(ns.dump, 'rb') as f:
+        regions = load(f.read())
+
+    if ns.csv:
+        print('Index, Type, Type(name), PhysicalStart, NumberOfPages, Attribute')
+        for i, r in enumerate(regions):
+            print(f'{i}, {r.type:x}, {type_name(r.type)}, {r.start:08x}, {r.pages:x}, {r.attribute & 0xfffff:x}')
+        return
+
+    summarize(regions, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
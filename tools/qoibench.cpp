@@ -0,0 +1,56 @@
+// QoiDecoder (kernel/qoi.cpp) の展開速度をホスト上で測るベンチマーク
+//
+//   cd kernel && make qoibench
+//   python ../tools/makewallpaper.py --width 1920 --height 1080 --noise 3 -o bench.qoi
+//   ./qoibench bench.qoi
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "qoi.hpp"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <image.qoi> [iterations]\n", argv[0]);
+        return 1;
+    }
+    const int iterations = argc > 2 ? atoi(argv[2]) : 50;
+
+    FILE *f = fopen(argv[1], "rb");
+    if (f == nullptr) {
+        perror(argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t              buf[65536];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+
+    QoiDecoder decoder;
+    if (!decoder.Open(data.data(), data.size())) {
+        fprintf(stderr, "%s: not a QOI image\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint32_t> row(decoder.Width());
+
+    uint32_t   checksum = 0;
+    const auto start    = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        decoder.Open(data.data(), data.size());
+        while (decoder.DecodeRow(row.data(), kPixelBGRResv8BitPerColor)) {
+            checksum += row[i % row.size()];
+        }
+    }
+    const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double pixels = static_cast<double>(decoder.Width()) * decoder.Height() * iterations;
+    printf("%s: %ux%u, %zu bytes, %d iterations (checksum %08x)\n", argv[1], decoder.Width(), decoder.Height(),
+           data.size(), iterations, checksum);
+    printf("  input  %8.1f MB/s\n", data.size() * iterations / sec / 1e6);
+    printf("  output %8.1f MB/s (%.1f Mpixel/s)\n", pixels * 4 / sec / 1e6, pixels / sec / 1e6);
+    return 0;
+}